@@ -0,0 +1,57 @@
+/* Loads key files into string_sets and reports how long it took.
+ *
+ * Usage: load_sets [-t threads] [-d] file ...
+ *   -t  number of threads to use (default: one per hardware thread)
+ *   -d  build the sets in descending order
+ *
+ * Jonathan Vidal-Contreras
+ * March 25, 2020
+ */
+
+#include "loader.h"
+#include "string_set.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+  int threads = 0;
+  bool ascending = true;
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+	threads = std::atoi(argv[++i]);
+      else if (std::strcmp(argv[i], "-d") == 0)
+	ascending = false;
+      else
+	break;
+    }
+  if (i >= argc || argv[i][0] == '-')
+    {
+      std::cerr << "Usage: " << argv[0] << " [-t threads] [-d] file ..." << std::endl;
+      return 2;
+    }
+
+  std::vector<std::string> paths(argv + i, argv + argc);
+  std::vector<cs3505::string_set*> sets;
+  for (int f = 0; f < paths.size(); f++)
+    sets.push_back(new cs3505::string_set(10, ascending));
+
+  cs3505::load_stats stats;
+  bool ok = cs3505::load_string_sets(paths, sets, threads, stats);
+
+  for (int f = 0; f < paths.size(); f++)
+    {
+      std::cout << paths[f] << ": " << sets[f]->get_size() << " keys" << std::endl;
+      delete sets[f];
+    }
+  std::cout << stats.files << " files, " << stats.lines << " lines, " << stats.keys
+	    << " keys in " << stats.seconds << " s ("
+	    << (stats.seconds > 0 ? stats.lines / stats.seconds : 0) << " lines/s, "
+	    << (stats.seconds > 0 ? stats.keys / stats.seconds : 0) << " keys/s)" << std::endl;
+
+  return ok ? 0 : 1;
+}
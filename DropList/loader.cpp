@@ -0,0 +1,234 @@
+/* Builds string_sets from newline-delimited key files.
+ * (See header file for details.)
+ *
+ * Jonathan Vidal-Contreras
+ * March 25, 2020
+ */
+
+#include "loader.h"
+#include "string_set.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  // Files are only split for parsing once each thread gets at least this much.
+  const size_t min_range_size = 1 << 20;
+
+  /* A line inside the mapped file, without its newline. */
+  struct key_ref
+  {
+    const char *data;
+    size_t length;
+  };
+
+  /*
+   * Orders keys the way std::string's operator< does (bytes compared as
+   * unsigned, a prefix first), so the merged keys come out in set order.
+   */
+  bool key_less(const key_ref & a, const key_ref & b)
+  {
+    int c = std::memcmp(a.data, b.data, std::min(a.length, b.length));
+    return c < 0 || (c == 0 && a.length < b.length);
+  }
+
+  /*
+   * Collects the lines in [begin, end) and sorts them.  begin is the start
+   * of a line.  Like std::getline, a newline at the very end does not start
+   * another (empty) line.
+   */
+  void parse_range(const char *begin, const char *end, std::vector<key_ref> & keys)
+  {
+    while (begin < end)
+      {
+	const char *eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+	if (eol == NULL)
+	  eol = end; // the last line has no newline
+
+	key_ref key = { begin, size_t(eol - begin) };
+	keys.push_back(key);
+	begin = eol + 1;
+      }
+
+    std::sort(keys.begin(), keys.end(), key_less);
+  }
+
+  /*
+   * Merges the sorted runs into one list of unique keys.  The keys still
+   * point into the mapping; add_sorted copies each one into its node.
+   * The runs that have keys left are kept in a heap on their next key,
+   * so each key costs O(lg runs) rather than a look at every run.
+   */
+  void merge_runs(const std::vector<std::vector<key_ref> > & runs,
+		  std::vector<std::pair<const char*, size_t> > & keys)
+  {
+    std::vector<size_t> pos(runs.size(), 0);
+    std::vector<int> heap; // the run with the smallest next key on top
+    const key_ref *prev = NULL;
+
+    // std::*_heap keep the largest element on top, so the order is reversed
+    auto after = [&](int a, int b) { return key_less(runs[b][pos[b]], runs[a][pos[a]]); };
+
+    for (int r = 0; r < runs.size(); r++)
+      if (!runs[r].empty())
+	heap.push_back(r);
+    std::make_heap(heap.begin(), heap.end(), after);
+
+    while (!heap.empty())
+      {
+	std::pop_heap(heap.begin(), heap.end(), after);
+	int best = heap.back();
+
+	const key_ref & key = runs[best][pos[best]++];
+	if (prev == NULL || key_less(*prev, key)) // skip duplicates
+	  keys.push_back(std::make_pair(key.data, key.length));
+	prev = &key;
+
+	if (pos[best] < runs[best].size())
+	  std::push_heap(heap.begin(), heap.end(), after); // back in on its next key
+	else
+	  heap.pop_back(); // this run is used up
+      }
+  }
+
+  /*
+   * Maps one file, parses it on up to 'threads' threads, and adds its keys
+   * to the set.  Adds to lines and keys what was read and added.
+   */
+  bool load_file(const std::string & path, cs3505::string_set & set, int threads,
+		 long & lines, long & keys)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) < 0)
+      {
+	std::cerr << path << ": " << std::strerror(errno) << std::endl;
+	if (fd >= 0)
+	  close(fd);
+	return false;
+      }
+
+    size_t size = st.st_size;
+    const char *data = NULL;
+    if (size > 0) // an empty file cannot be mapped, and has no keys anyway
+      {
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+	  {
+	    std::cerr << path << ": " << std::strerror(errno) << std::endl;
+	    close(fd);
+	    return false;
+	  }
+	madvise(map, size, MADV_SEQUENTIAL);
+	data = static_cast<const char*>(map);
+      }
+    close(fd); // the mapping keeps the file open
+
+    // split the file into one range per thread, each starting at a line
+    threads = std::max(1, std::min<int>(threads, size / min_range_size));
+    const char *end = data + size;
+    std::vector<const char*> bounds(threads + 1, end);
+    bounds[0] = data;
+    for (int t = 1; t < threads; t++)
+      {
+	const char *p = std::max(data + size / threads * t, bounds[t - 1]);
+	if (p > data && p < end && p[-1] != '\n')
+	  {
+	    const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+	    p = eol ? eol + 1 : end;
+	  }
+	bounds[t] = p;
+      }
+
+    std::vector<std::vector<key_ref> > runs(threads);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+      workers.push_back(std::thread(parse_range, bounds[t], bounds[t + 1], std::ref(runs[t])));
+    parse_range(bounds[0], bounds[1], runs[0]);
+    for (int t = 0; t < workers.size(); t++)
+      workers[t].join();
+
+    for (int t = 0; t < threads; t++)
+      lines += runs[t].size();
+
+    std::vector<std::pair<const char*, size_t> > unique;
+    merge_runs(runs, unique);
+    runs.clear();
+
+    if (!set.is_ascending())
+      std::reverse(unique.begin(), unique.end());
+
+    int before = set.get_size();
+    set.add_sorted(unique);
+    keys += set.get_size() - before;
+
+    unique.clear(); // the keys point into the mapping
+    if (data != NULL)
+      munmap(const_cast<char*>(data), size);
+
+    return true;
+  }
+}
+
+bool cs3505::load_string_sets(const std::vector<std::string> & paths,
+			      const std::vector<string_set*> & sets,
+			      int threads, load_stats & stats)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int nb_files = paths.size();
+
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // load several files at once, and share the threads between them
+  int nb_workers = std::max(1, std::min(threads, nb_files));
+  int threads_per_file = std::max(1, threads / nb_workers);
+
+  std::atomic<int> next_file(0);
+  std::vector<long> lines(nb_files, 0), keys(nb_files, 0);
+  std::vector<char> ok(nb_files, 1); // not vector<bool>, so threads can write their own entries
+
+  std::function<void()> worker = [&]()
+    {
+      for (int i = next_file++; i < nb_files; i = next_file++)
+	ok[i] = load_file(paths[i], *sets[i], threads_per_file, lines[i], keys[i]);
+    };
+
+  std::vector<std::thread> workers;
+  for (int w = 1; w < nb_workers; w++)
+    workers.push_back(std::thread(worker));
+  worker();
+  for (int w = 0; w < workers.size(); w++)
+    workers[w].join();
+
+  stats.files = nb_files;
+  stats.lines = stats.keys = 0;
+  bool all_ok = true;
+  for (int i = 0; i < nb_files; i++)
+    {
+      stats.lines += lines[i];
+      stats.keys += keys[i];
+      all_ok = all_ok && ok[i];
+    }
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  return all_ok;
+}
+
+bool cs3505::load_string_set(const std::string & path, string_set & set,
+			     int threads, load_stats & stats)
+{
+  return load_string_sets(std::vector<std::string>(1, path),
+			  std::vector<string_set*>(1, &set), threads, stats);
+}
@@ -0,0 +1,45 @@
+/* Builds string_sets from newline-delimited key files.
+ *
+ * Each file is memory-mapped and split into line ranges that are parsed
+ * and sorted in parallel, pointing into the mapping instead of copying
+ * each line.  The sorted runs are merged with duplicates dropped, still
+ * pointing into the mapping, and string_set::add_sorted builds the set in
+ * one pass, copying each unique key only into its node.  The resulting sets hold exactly what reading each
+ * line with std::getline and calling add would give.
+ *
+ * Jonathan Vidal-Contreras
+ * March 25, 2020
+ */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <string>
+#include <vector>
+#include "string_set.h"
+
+namespace cs3505
+{
+  /* What a load did and how long it took. */
+  struct load_stats
+  {
+    int files;        // files loaded
+    long lines;       // lines read, duplicates included
+    long keys;        // keys added to the sets
+    double seconds;   // wall clock time of the whole load
+  };
+
+  // Loads the keys in paths[i] into *sets[i], using up to 'threads' threads
+  // in total (0 = one per hardware thread).  Files are loaded at the same
+  // time when there are fewer threads than files.  Returns false if a file
+  // could not be read; the error is printed to std::cerr.
+  bool load_string_sets(const std::vector<std::string> & paths,
+			const std::vector<string_set*> & sets,
+			int threads, load_stats & stats);
+
+  // Same as above for a single file.
+  bool load_string_set(const std::string & path, string_set & set,
+		       int threads, load_stats & stats);
+}
+
+#endif
@@ -52,6 +52,15 @@ cs3505::node::node(const std:: string & s, int width)
   //new_node_count++;
 }
 
+/*
+ * Same as above, with the data given as the first length chars at data,
+ * so callers holding them in a buffer do not need a std::string first.
+ */
+cs3505::node::node(const char *data, size_t length, int width)
+  : data(data, length), next(width, NULL)
+{
+}
+
 cs3505::node::~node()
 {
   for (int i = 0; i < next.size(); i++)
@@ -35,6 +35,7 @@ namespace cs3505
     // Students must decide what functions and variables are needed here.
 
      node(const std::string & data, int width);
+     node(const char *data, size_t length, int width);
      ~node();
 
      std::string data;
@@ -20,7 +20,7 @@
 #include "string_set.h"
 #include "node.h"
 #include <iostream>  // For debugging, if needed.
-#include <stdlib.h>
+#include <random>
 
 
 namespace cs3505
@@ -123,6 +123,59 @@ namespace cs3505
     size++;
   }
 
+  /*
+   * Adds elements that are already sorted in this set's order (ascending or
+   * descending).  When the set starts out empty, each element that comes after
+   * the last one added is linked in at the end of every level it reaches, which
+   * is O(1) instead of a traversal.  Anything else (duplicates, elements out of
+   * order, a set that already has elements) goes through add.  The elements
+   * are (chars, length) pairs, so they can point into a buffer such as a
+   * mapped file; each is copied once, into its node.
+   */
+  void string_set::add_sorted(const std::vector<std::pair<const char*, size_t> > & elements)
+  {
+    if (size != 0)
+      {
+	for (int i = 0; i < elements.size(); i++)
+	  add(std::string(elements[i].first, elements[i].second));
+	return;
+      }
+
+    std::vector<node*> last(max_next_width, head); // the last node on each level
+
+    for (int i = 0; i < elements.size(); i++)
+      {
+	const char *target = elements[i].first;
+	size_t length = elements[i].second;
+
+	// where the last node is compared to the target (< 0: before it)
+	int order = last[0]->data.compare(0, std::string::npos, target, length);
+
+	if (last[0] != head && (ascending ? order >= 0 : order <= 0))
+	  {
+	    add(std::string(target, length)); // does not go at the end of level 0
+
+	    // but on a higher level it can land after the last node there,
+	    // so walk each level on to its real end before appending again
+	    for (int j = 0; j < max_next_width; j++)
+	      while (last[j]->next[j] != NULL)
+		last[j] = last[j]->next[j];
+	    continue;
+	  }
+
+	int height = get_height_of_next();
+	node* to_add = new node(target, length, height);
+
+	for (int j = 0; j < height; j++) // append on every level the node reaches
+	  {
+	    last[j]->next[j] = to_add;
+	    last[j] = to_add;
+	  }
+
+	size++;
+      }
+  }
+
   /*
    * Removes an element from the string_set, given that it exists within the data structure
    */
@@ -291,12 +344,16 @@ namespace cs3505
    * Randomly determines the height of each node's next pointers.
    * Vectors are guaranteed to have at least one, so this will determine 
    * the number of subsequent pointers.
+   *
+   * Sets are built on several threads at once (see loader.cpp), so each
+   * thread draws from its own generator; rand() is not safe to share.
    */
  const int cs3505::string_set::get_height_of_next()
   {
+    static thread_local std::minstd_rand random; // one per thread
     int total_height = 1; // ALL node* vectors are guaranteed height of at least 1.
 
-    while(rand() % 2 == 1 && total_height < max_next_width)
+    while(random() % 2 == 1 && total_height < max_next_width)
       {
        	total_height++;
       }
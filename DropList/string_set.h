@@ -20,6 +20,7 @@
 #ifndef STRING_SET_H
 #define STRING_SET_H
 
+#include <utility>
 #include "node.h"  
 
 namespace cs3505
@@ -49,6 +50,8 @@ namespace cs3505
       ~string_set();                         // Destructor
 
       void add      (const std::string & target);        // Not const - modifies the object
+      void add_sorted (const std::vector<std::pair<const char*, size_t> > & elements); // Adds elements already in this set's
+                                                                                      // order, given as (chars, length)
       void remove   (const std::string & target);        // Not const - modifies the object
       bool contains (const std::string & target) const;  // Const - does not change the object
       int  get_size () const;                            // Const - does not change object
@@ -0,0 +1,272 @@
+/*
+ * asifconv: converts ASIF files, or every .asif file in a directory,
+ * to 8-bit WAV files with libasif.
+ *
+ * Usage: asifconv [-n] [-o output_dir] file.asif|directory ...
+ *
+ * -n only decodes, without writing anything, to measure decoding speed,
+ * the time until the first samples are out, and peak memory.
+ *
+ * Plain and entropy coded (Rice) files are counted apart, with their
+ * compression ratio (samples out per byte of file) and speed.
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "libasif.h"
+
+#define CHUNK_SAMPLES (1 << 16) // samples per channel converted at a time
+
+/*
+ * Totals for one kind of file, plain or Rice coded.
+ */
+typedef struct Totals {
+  int nb_files;
+  uint64_t bytes_in; // size of the files
+  uint64_t bytes_out; // bytes of samples decoded from them
+  double secs;
+} Totals;
+
+static const char *output_dir; // NULL = next to the input
+static int decode_only;
+static int nb_converted, nb_failed;
+static Totals totals[2]; // indexed by whether the file is Rice coded
+static double max_first_chunk; // longest time from opening a file to its first decoded samples
+
+static double now(void){
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void put_le16(uint8_t *p, unsigned v){
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v){
+  put_le16(p, v);
+  put_le16(p + 2, v >> 16);
+}
+
+/*
+ * Writes a 44 byte WAV header for unsigned 8-bit PCM, which is exactly what
+ * ASIF samples are, so the data only needs interleaving.
+ */
+static int write_wav_header(FILE *out, const ASIFHeader *h, uint32_t data_size){
+  uint8_t hdr[44];
+
+  memcpy(hdr, "RIFF", 4);
+  put_le32(hdr + 4, 36 + data_size);
+  memcpy(hdr + 8, "WAVEfmt ", 8);
+  put_le32(hdr + 16, 16);
+  put_le16(hdr + 20, 1); // PCM
+  put_le16(hdr + 22, h->channels);
+  put_le32(hdr + 24, h->sample_rate);
+  put_le32(hdr + 28, h->sample_rate * h->channels);
+  put_le16(hdr + 32, h->channels);
+  put_le16(hdr + 34, 8);
+  memcpy(hdr + 36, "data", 4);
+  put_le32(hdr + 40, data_size);
+
+  return fwrite(hdr, sizeof(hdr), 1, out) == 1 ? 0 : -1;
+}
+
+/*
+ * Builds the output name: the input name with .wav instead of .asif, in
+ * output_dir if one was given.
+ */
+static char *output_name(const char *path){
+  const char *base = strrchr(path, '/');
+  const char *dot;
+  size_t len;
+  char *name;
+
+  base = base ? base + 1 : path;
+  dot  = strrchr(base, '.');
+  len  = dot && strcmp(dot, ".asif") == 0 ? (size_t)(dot - base) : strlen(base);
+
+  name = malloc((output_dir ? strlen(output_dir) + 1 : (size_t)(base - path)) + len + 5);
+  if (!name)
+    return NULL;
+  if (output_dir)
+    sprintf(name, "%s/%.*s.wav", output_dir, (int)len, base);
+  else
+    sprintf(name, "%.*s.wav", (int)((base - path) + len), path);
+  return name;
+}
+
+static int convert_file(const char *path){
+  ASIFFile *file;
+  ASIFReader *reader = NULL;
+  const ASIFHeader *h;
+  Totals *t;
+  struct stat st;
+  uint8_t *buf = NULL;
+  uint64_t nb_samples, done;
+  int64_t len;
+  char *name = NULL;
+  FILE *out = NULL;
+  double start = now();
+  int ret;
+
+  if ((ret = asif_open(&file, path)) < 0) {
+    fprintf(stderr, "%s: %s\n", path, asif_strerror(ret));
+    return -1;
+  }
+  h = asif_get_header(file);
+  nb_samples = asif_get_nb_samples(file);
+
+  if (!decode_only && nb_samples * h->channels > UINT32_MAX - 36) {
+    fprintf(stderr, "%s: too long for a WAV file\n", path);
+    ret = -1;
+    goto end;
+  }
+
+  name = output_name(path);
+  buf  = malloc((size_t)CHUNK_SAMPLES * h->channels);
+  if (!name || !buf || asif_reader_open(&reader, file) < 0) {
+    fprintf(stderr, "%s: %s\n", path, asif_strerror(ASIF_ERR_NOMEM));
+    ret = -1;
+    goto end;
+  }
+  if (!decode_only)
+    out = fopen(name, "wb");
+  if (!decode_only && (!out || write_wav_header(out, h, nb_samples * h->channels) < 0)) {
+    perror(name);
+    ret = -1;
+    goto end;
+  }
+
+  for (done = 0; done < nb_samples; done += len) {
+    // every channel is decoded straight into its interleaved positions
+    if ((len = asif_reader_read(reader, buf, CHUNK_SAMPLES)) <= 0) {
+      fprintf(stderr, "%s: %s\n", path, asif_strerror(len < 0 ? len : ASIF_ERR_INVALID));
+      ret = -1;
+      goto end;
+    }
+    if (!done && now() - start > max_first_chunk)
+      max_first_chunk = now() - start;
+    if (out && fwrite(buf, h->channels, len, out) != len) {
+      perror(name);
+      ret = -1;
+      goto end;
+    }
+  }
+  t = &totals[!!(h->flags & ASIF_FLAG_RICE)];
+  t->nb_files++;
+  t->bytes_in  += stat(path, &st) ? 0 : st.st_size;
+  t->bytes_out += nb_samples * h->channels;
+  t->secs      += now() - start;
+
+end:
+  if (out && fclose(out) && !ret) {
+    perror(name);
+    ret = -1;
+  }
+  free(name);
+  free(buf);
+  asif_reader_close(reader);
+  asif_close(file);
+  return ret;
+}
+
+/*
+ * Converts every file ending in .asif directly inside the directory.
+ */
+static void convert_dir(const char *path){
+  DIR *dir = opendir(path);
+  struct dirent *entry;
+  const char *dot;
+  char *name;
+
+  if (!dir) {
+    perror(path);
+    nb_failed++;
+    return;
+  }
+
+  while ((entry = readdir(dir))) {
+    dot = strrchr(entry->d_name, '.');
+    if (!dot || strcmp(dot, ".asif"))
+      continue;
+
+    name = malloc(strlen(path) + strlen(entry->d_name) + 2);
+    if (!name) {
+      nb_failed++;
+      continue;
+    }
+    sprintf(name, "%s/%s", path, entry->d_name);
+    if (convert_file(name) < 0)
+      nb_failed++;
+    else
+      nb_converted++;
+    free(name);
+  }
+  closedir(dir);
+}
+
+/*
+ * Prints how much one kind of file was compressed and how fast it went.
+ */
+static void print_totals(const char *kind, const Totals *t){
+  if (!t->nb_files)
+    return;
+  printf("  %-5s %d files, %.1f MB of samples from %.1f MB (ratio %.2f), %.1f MB/s\n",
+         kind, t->nb_files, t->bytes_out / 1e6, t->bytes_in / 1e6,
+         t->bytes_in ? (double)t->bytes_out / t->bytes_in : 0,
+         t->secs > 0 ? t->bytes_out / 1e6 / t->secs : 0);
+}
+
+int main(int argc, char **argv){
+  struct rusage usage;
+  struct stat st;
+  uint64_t bytes_out;
+  double t0, secs;
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-n"))
+      decode_only = 1;
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      output_dir = argv[++i];
+    else
+      break;
+  }
+  if (i >= argc || argv[i][0] == '-') {
+    fprintf(stderr, "Usage: %s [-n] [-o output_dir] file.asif|directory ...\n", argv[0]);
+    return 2;
+  }
+
+  t0 = now();
+  for (; i < argc; i++) {
+    if (!stat(argv[i], &st) && S_ISDIR(st.st_mode))
+      convert_dir(argv[i]);
+    else if (convert_file(argv[i]) < 0)
+      nb_failed++;
+    else
+      nb_converted++;
+  }
+  secs = now() - t0;
+  bytes_out = totals[0].bytes_out + totals[1].bytes_out;
+
+  printf("%d %s, %d failed, %.1f MB of samples in %.3f s (%.1f MB/s)\n",
+         nb_converted, decode_only ? "decoded" : "converted", nb_failed,
+         bytes_out / 1e6, secs, secs > 0 ? bytes_out / 1e6 / secs : 0);
+  print_totals("plain", &totals[0]);
+  print_totals("rice", &totals[1]);
+  if (decode_only && !getrusage(RUSAGE_SELF, &usage))
+    printf("first samples after at most %.3f ms, peak memory %ld kB\n",
+           max_first_chunk * 1e3, usage.ru_maxrss);
+
+  return nb_failed ? 1 : 0;
+}
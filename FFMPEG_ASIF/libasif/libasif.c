@@ -0,0 +1,405 @@
+/*
+ * libasif: a standalone ASIF reader
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "libasif.h"
+
+/*
+ * A run of samples stored together. A version 1 file is a single block
+ * holding the whole file.
+ */
+typedef struct ASIFBlock {
+  const uint8_t *payload; // points into the mapping
+  uint64_t size; // bytes in the payload, over 4 GB for a long version 1 file
+  uint64_t nb_samples; // samples per channel in the block
+  uint64_t start; // index of the block's first sample
+} ASIFBlock;
+
+struct ASIFFile {
+  const uint8_t *data; // the whole file, mapped read-only
+  size_t size;
+  ASIFHeader header;
+  uint64_t nb_samples; // samples per channel in all the blocks
+  ASIFBlock *blocks;
+  size_t nb_blocks;
+  uint64_t max_block; // largest nb_samples of any block
+};
+
+struct ASIFReader {
+  const ASIFFile *file;
+  size_t block; // the block of the next sample
+  uint64_t pos; // the next sample in that block
+  uint8_t *last; // each channel's last sample
+  uint8_t *unpacked; // every channel's deltas of the current Rice block
+};
+
+/*
+ * Reads bits most significant first, like FFmpeg's GetBitContext. Reading
+ * past the end gives zeros; the caller checks pos against size afterwards.
+ */
+typedef struct BitReader {
+  const uint8_t *buf;
+  size_t size; // in bits
+  size_t pos;
+} BitReader;
+
+static unsigned read_bits(BitReader *br, int n){
+  unsigned value = 0;
+
+  while (n--){
+    unsigned bit = 0;
+    if (br->pos < br->size)
+      bit = br->buf[br->pos >> 3] >> (7 - (br->pos & 7)) & 1;
+    br->pos++;
+    value = value << 1 | bit;
+  }
+  return value;
+}
+
+/*
+ * Reads a value written by FFmpeg's set_ur_golomb with the ASIF limits.
+ */
+static unsigned read_rice(BitReader *br, int k){
+  unsigned zeros = 0;
+
+  while (zeros < ASIF_RICE_LIMIT && !read_bits(br, 1))
+    zeros++;
+  if (zeros == ASIF_RICE_LIMIT) // escaped, the value follows as it is
+    return read_bits(br, ASIF_RICE_ESC_LEN) + ASIF_RICE_LIMIT - 1;
+  return zeros << k | read_bits(br, k);
+}
+
+/*
+ * Entropy decodes the first nb_channels channels of a Rice coded block
+ * into plain deltas, each channel's after the one before, as in a plain
+ * block. The channels are coded one after the other, so a channel cannot
+ * be reached without decoding the ones before it.
+ */
+static int unpack_rice(const ASIFBlock *b, int nb_channels, uint8_t *deltas){
+  BitReader br = { b->payload + 4, ((size_t)b->size - 4) * 8, 0 };
+  unsigned u;
+  int k;
+
+  for (int c = 0; c < nb_channels; c++, deltas += b->nb_samples){
+    deltas[0] = read_bits(&br, 8); // the initial sample
+    k = read_bits(&br, 4);
+    if (k > ASIF_RICE_RAW)
+      return ASIF_ERR_INVALID;
+
+    for (uint64_t i = 1; i < b->nb_samples; i++){
+      if (k == ASIF_RICE_RAW) {
+        deltas[i] = read_bits(&br, 8);
+      } else {
+        u = read_rice(&br, k);
+        deltas[i] = (u >> 1) ^ -(u & 1); // undo the zigzag mapping
+      }
+    }
+    if (br.pos > br.size)
+      return ASIF_ERR_INVALID;
+  }
+  return 0;
+}
+
+static int add_block(ASIFFile *f, const uint8_t *payload, uint64_t size, uint64_t nb_samples){
+  ASIFBlock *blocks;
+
+  if (!(f->nb_blocks & (f->nb_blocks - 1))) { // grow at every power of two
+    blocks = realloc(f->blocks, (f->nb_blocks ? 2 * f->nb_blocks : 1) * sizeof(*blocks));
+    if (!blocks)
+      return ASIF_ERR_NOMEM;
+    f->blocks = blocks;
+  }
+
+  f->blocks[f->nb_blocks++] = (ASIFBlock) { payload, size, nb_samples, f->nb_samples };
+  f->nb_samples += nb_samples;
+  if (nb_samples > f->max_block)
+    f->max_block = nb_samples;
+  return 0;
+}
+
+/*
+ * A version 1 file is one block with every channel's deltas. When the
+ * length is unknown (written to a pipe), the deltas run to the end.
+ */
+static int find_v1_data(ASIFFile *f){
+  const ASIFHeader *h = &f->header;
+  uint64_t data_size = f->size - h->size;
+  uint64_t nb_samples = h->nb_samples;
+
+  if (nb_samples == ASIF_UNKNOWN_SAMPLES)
+    nb_samples = data_size / h->channels;
+  if (nb_samples * h->channels > data_size)
+    return ASIF_ERR_INVALID;
+
+  if (!nb_samples)
+    return 0;
+  return add_block(f, f->data + h->size, nb_samples * h->channels, nb_samples);
+}
+
+/*
+ * Walks the version 2 block headers up to the empty block that ends the
+ * data, or up to the end of a file that was cut short between blocks.
+ */
+static int find_v2_blocks(ASIFFile *f){
+  const ASIFHeader *h = &f->header;
+  size_t pos = h->size;
+  uint32_t nb_samples, size;
+  int ret;
+
+  while (f->size - pos >= ASIF_BLOCK_HEADER_SIZE) {
+    nb_samples = asif_rl32(f->data + pos);
+    size       = asif_rl32(f->data + pos + 4);
+    pos += ASIF_BLOCK_HEADER_SIZE;
+
+    if (!nb_samples)
+      break;
+    if (nb_samples > ASIF_MAX_BLOCK_SIZE || size > f->size - pos)
+      return ASIF_ERR_INVALID;
+    if (h->flags & ASIF_FLAG_RICE) {
+      if (size < 4 || asif_rl32(f->data + pos) != nb_samples)
+        return ASIF_ERR_INVALID;
+    } else if (size != (uint64_t)nb_samples * h->channels) {
+      return ASIF_ERR_INVALID;
+    }
+
+    if ((ret = add_block(f, f->data + pos, size, nb_samples)) < 0)
+      return ret;
+    pos += size;
+  }
+  return 0;
+}
+
+int asif_open(ASIFFile **file, const char *path){
+  ASIFFile *f;
+  struct stat st;
+  void *data;
+  int fd, ret;
+
+  *file = NULL;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return ASIF_ERR_IO;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return ASIF_ERR_IO;
+  }
+  if (st.st_size < ASIF_V1_HEADER_SIZE) { // nothing to map
+    close(fd);
+    return ASIF_ERR_TRUNCATED;
+  }
+
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file open
+  if (data == MAP_FAILED)
+    return ASIF_ERR_IO;
+
+  f = calloc(1, sizeof(*f));
+  if (!f) {
+    munmap(data, st.st_size);
+    return ASIF_ERR_NOMEM;
+  }
+  f->data = data;
+  f->size = st.st_size;
+
+  ret = asif_parse_header(&f->header, f->data, f->size);
+  if (!ret)
+    ret = f->header.version == 2 ? find_v2_blocks(f) : find_v1_data(f);
+  if (ret < 0) {
+    asif_close(f);
+    return ret;
+  }
+
+  *file = f;
+  return 0;
+}
+
+void asif_close(ASIFFile *file){
+  if (!file)
+    return;
+  munmap((void *)file->data, file->size);
+  free(file->blocks);
+  free(file);
+}
+
+const ASIFHeader *asif_get_header(const ASIFFile *file){
+  return &file->header;
+}
+
+uint64_t asif_get_nb_samples(const ASIFFile *file){
+  return file->nb_samples;
+}
+
+/*
+ * Index of the block holding the sample.
+ */
+static size_t find_block(const ASIFFile *f, uint64_t sample){
+  size_t lo = 0, hi = f->nb_blocks - 1, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo + 1) / 2;
+    if (f->blocks[mid].start <= sample)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+int asif_read_channel(ASIFFile *file, int channel, uint64_t start, size_t count,
+                      uint8_t *dst, ptrdiff_t stride){
+  const ASIFBlock *b;
+  const uint8_t *deltas;
+  uint8_t *unpacked = NULL;
+  uint8_t sample;
+  uint64_t from, len;
+  size_t i;
+  int ret = 0;
+
+  if (channel < 0 || channel >= file->header.channels ||
+      start > file->nb_samples || count > file->nb_samples - start)
+    return ASIF_ERR_RANGE;
+  if (!count)
+    return 0;
+
+  if (file->header.flags & ASIF_FLAG_RICE) { // per call, so threads do not share it
+    unpacked = malloc(file->max_block * (channel + 1));
+    if (!unpacked)
+      return ASIF_ERR_NOMEM;
+  }
+
+  for (i = find_block(file, start); count; i++) {
+    b    = &file->blocks[i];
+    from = start - b->start;
+    len  = b->nb_samples - from;
+    if (len > count)
+      len = count;
+
+    if (unpacked) {
+      if ((ret = unpack_rice(b, channel + 1, unpacked)) < 0)
+        break;
+      deltas = unpacked + (size_t)channel * b->nb_samples;
+    } else {
+      deltas = b->payload + (size_t)channel * b->nb_samples;
+    }
+
+    // every block starts from 0, so the sample before the range is a sum
+    sample = 0;
+    for (uint64_t j = 0; j < from; j++)
+      sample += deltas[j];
+
+    if (stride == 1) {
+      asif_decode_run(dst, deltas + from, len, sample);
+    } else {
+      for (uint64_t j = 0; j < len; j++){
+        sample += deltas[from + j];
+        dst[j * stride] = sample;
+      }
+    }
+
+    dst   += len * stride;
+    start += len;
+    count -= len;
+  }
+
+  free(unpacked);
+  return ret;
+}
+
+int asif_reader_open(ASIFReader **reader, const ASIFFile *file){
+  ASIFReader *r;
+  int channels = file->header.channels;
+
+  *reader = NULL;
+
+  r = calloc(1, sizeof(*r));
+  if (!r)
+    return ASIF_ERR_NOMEM;
+  r->file = file;
+  r->last = malloc(channels);
+  if ((file->header.flags & ASIF_FLAG_RICE) && file->nb_blocks)
+    r->unpacked = malloc(file->max_block * channels);
+  if (!r->last || ((file->header.flags & ASIF_FLAG_RICE) && file->nb_blocks && !r->unpacked)) {
+    asif_reader_close(r);
+    return ASIF_ERR_NOMEM;
+  }
+
+  *reader = r;
+  return 0;
+}
+
+void asif_reader_close(ASIFReader *reader){
+  if (!reader)
+    return;
+  free(reader->last);
+  free(reader->unpacked);
+  free(reader);
+}
+
+int64_t asif_reader_read(ASIFReader *reader, uint8_t *dst, size_t count){
+  const ASIFFile *f = reader->file;
+  const ASIFBlock *b;
+  const uint8_t *deltas;
+  int channels = f->header.channels;
+  uint8_t sample, *out;
+  uint64_t len;
+  size_t done = 0;
+  int ret;
+
+  while (done < count && reader->block < f->nb_blocks) {
+    b = &f->blocks[reader->block];
+
+    // a Rice block is unpacked once, when the reader gets to it
+    if (reader->unpacked && !reader->pos && (ret = unpack_rice(b, channels, reader->unpacked)) < 0)
+      return ret;
+
+    len = b->nb_samples - reader->pos;
+    if (len > count - done)
+      len = count - done;
+
+    for (int c = 0; c < channels; c++) {
+      deltas = (reader->unpacked ? reader->unpacked : b->payload) + c * b->nb_samples + reader->pos;
+      out    = dst + done * channels + c;
+      sample = reader->pos ? reader->last[c] : 0; // every block starts from 0
+
+      if (channels == 1) {
+        sample = asif_decode_run(out, deltas, len, sample);
+      } else {
+        for (uint64_t j = 0; j < len; j++){
+          sample += deltas[j];
+          out[j * channels] = sample;
+        }
+      }
+      reader->last[c] = sample;
+    }
+
+    done        += len;
+    reader->pos += len;
+    if (reader->pos == b->nb_samples) {
+      reader->block++;
+      reader->pos = 0;
+    }
+  }
+  return done;
+}
+
+const char *asif_strerror(int err){
+  switch (err) {
+  case 0:                  return "Success";
+  case ASIF_ERR_TRUNCATED: return "File too short for an ASIF header";
+  case ASIF_ERR_INVALID:   return "Invalid ASIF data";
+  case ASIF_ERR_IO:        return "Could not open or map the file";
+  case ASIF_ERR_NOMEM:     return "Out of memory";
+  case ASIF_ERR_RANGE:     return "Channel or samples out of range";
+  default:                 return "Unknown error";
+  }
+}
@@ -0,0 +1,90 @@
+/*
+ * libasif: a standalone ASIF reader
+ *
+ * Maps a file into memory and decodes ranges of a channel, or the whole
+ * file in order, straight from the mapped pages into the caller's buffer,
+ * without FFmpeg. Header parsing and delta decoding are the ones in
+ * libavcodec/asif.h, so both read files the same way.
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#ifndef LIBASIF_H
+#define LIBASIF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../libavcodec/asif.h"
+
+/*
+ * Errors, on top of the ones from asif_parse_header
+ */
+#define ASIF_ERR_IO            (-3) // the file could not be opened or mapped, errno tells why
+#define ASIF_ERR_NOMEM         (-4)
+#define ASIF_ERR_RANGE         (-5) // the channel or samples are not in the file
+
+typedef struct ASIFFile ASIFFile;
+typedef struct ASIFReader ASIFReader;
+
+/*
+ * Maps the file at path, checks the header and finds every block.
+ * Returns 0 and sets *file, or a negative ASIF_ERR_* value.
+ */
+int asif_open(ASIFFile **file, const char *path);
+
+/*
+ * Unmaps the file and frees it. Accepts NULL.
+ */
+void asif_close(ASIFFile *file);
+
+/*
+ * The parsed header. Its nb_samples may be ASIF_UNKNOWN_SAMPLES, use
+ * asif_get_nb_samples for the actual length.
+ */
+const ASIFHeader *asif_get_header(const ASIFFile *file);
+
+/*
+ * Samples per channel actually in the file.
+ */
+uint64_t asif_get_nb_samples(const ASIFFile *file);
+
+/*
+ * Decodes count samples of a channel, starting at sample start, as unsigned
+ * 8-bit values into dst[0], dst[stride], dst[2 * stride], ... A stride of 1
+ * gives planar output, a stride of the number of channels interleaved output.
+ * Different channels can be read from different threads at the same time.
+ * Returns 0 or a negative ASIF_ERR_* value.
+ */
+int asif_read_channel(ASIFFile *file, int channel, uint64_t start, size_t count,
+                      uint8_t *dst, ptrdiff_t stride);
+
+/*
+ * A reader goes through every channel of a file once, from the first
+ * sample to the last, keeping each channel's last sample between calls and
+ * unpacking each Rice coded block only once, so reading a whole file takes
+ * one pass. asif_read_channel instead starts over from the beginning of a
+ * block on every call. The file must stay open while the reader is used.
+ * Returns 0 and sets *reader, or a negative ASIF_ERR_* value.
+ */
+int asif_reader_open(ASIFReader **reader, const ASIFFile *file);
+
+/*
+ * Frees the reader. Accepts NULL.
+ */
+void asif_reader_close(ASIFReader *reader);
+
+/*
+ * Decodes the next count samples of every channel, as unsigned 8-bit values
+ * interleaved into dst (count * channels bytes). Returns the number of
+ * samples per channel decoded, which is less than count only at the end of
+ * the file, or a negative ASIF_ERR_* value.
+ */
+int64_t asif_reader_read(ASIFReader *reader, uint8_t *dst, size_t count);
+
+/*
+ * Describes an ASIF_ERR_* value.
+ */
+const char *asif_strerror(int err);
+
+#endif /* LIBASIF_H */
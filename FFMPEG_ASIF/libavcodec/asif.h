@@ -0,0 +1,167 @@
+/*
+ * ASIF definitions shared by the codec, the (de)muxer and libasif
+ *
+ * Everything here is plain C without any FFmpeg dependency, so the
+ * standalone library in libasif/ parses and decodes files the same way.
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#ifndef AVCODEC_ASIF_H
+#define AVCODEC_ASIF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASIF_MKTAG(a, b, c, d) ((a) | ((b) << 8) | ((c) << 16) | ((unsigned)(d) << 24))
+
+/*
+ * Version 1 files: 'asif', sample rate (le32), channels (le16),
+ * samples per channel (le32), then every channel's initial sample and
+ * deltas one after the other.
+ */
+#define ASIF_TAG               ASIF_MKTAG('a', 's', 'i', 'f')
+#define ASIF_V1_HEADER_SIZE    14
+
+/*
+ * Version 2 files: 'asi2', sample rate (le32), channels (le16), samples
+ * per channel (le32), block size (le32), flags (le16), then a series of
+ * blocks.  Each block is the number of samples per channel in it (le32)
+ * and its payload size (le32), followed by a version 1 style payload:
+ * for every channel an absolute sample and (n - 1) deltas.  A block
+ * with 0 samples ends the data and is followed by the seek index:
+ * block count (le32), the file offset of each block (le64), the offset
+ * of the seek index itself (le64) and the tag 'asix'.
+ */
+#define ASIF_V2_TAG            ASIF_MKTAG('a', 's', 'i', '2')
+#define ASIF_V2_HEADER_SIZE    20
+#define ASIF_BLOCK_HEADER_SIZE 8
+#define ASIF_INDEX_TAG         ASIF_MKTAG('a', 's', 'i', 'x')
+
+/*
+ * Samples per channel written in the header when the length was not known,
+ * e.g. when writing to a pipe. Readers then read the data up to the end
+ * of the file (version 1) or the block list (version 2).
+ */
+#define ASIF_UNKNOWN_SAMPLES   0xFFFFFFFF
+
+#define ASIF_DEFAULT_BLOCK_SIZE 4096
+#define ASIF_MAX_BLOCK_SIZE     (1 << 20)
+
+/*
+ * Header flags
+ *
+ * ASIF_FLAG_RICE: version 2 blocks are entropy coded. A block is the
+ * number of samples per channel (le32), then a bit stream with, for every
+ * channel, the initial sample (8 bits), a Rice parameter (4 bits) and the
+ * zigzag-mapped deltas coded with that parameter, escaped after
+ * ASIF_RICE_LIMIT unary bits. A parameter of ASIF_RICE_RAW means the deltas
+ * are stored as plain bytes. Blocks still decode on their own.
+ */
+#define ASIF_FLAG_RICE         0x0001
+
+#define ASIF_RICE_LIMIT        16
+#define ASIF_RICE_ESC_LEN      8
+#define ASIF_RICE_RAW          8
+
+/*
+ * Codec extradata, used to tell the muxer and decoder which layout is
+ * in use: version (le16), flags (le16), block size (le32).  Streams
+ * without extradata are version 1.
+ */
+#define ASIF_EXTRADATA_SIZE    8
+
+/*
+ * Return values of asif_parse_header
+ */
+#define ASIF_ERR_TRUNCATED     (-1) // not enough bytes for the whole header
+#define ASIF_ERR_INVALID       (-2) // not an ASIF header, or nonsensical values
+
+/*
+ * The fields of a version 1 or 2 header. Version 1 headers leave
+ * block_size and flags at 0.
+ */
+typedef struct ASIFHeader {
+  int version;
+  uint32_t sample_rate;
+  int channels;
+  uint32_t nb_samples; // samples per channel, or ASIF_UNKNOWN_SAMPLES
+  uint32_t block_size;
+  int flags;
+  int size; // bytes taken by the header
+} ASIFHeader;
+
+static inline uint32_t asif_rl16(const uint8_t *p){
+  return p[0] | p[1] << 8;
+}
+
+static inline uint32_t asif_rl32(const uint8_t *p){
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/*
+ * Parses the header at the start of buf. Returns 0, or ASIF_ERR_TRUNCATED
+ * if size is too small to tell, or ASIF_ERR_INVALID.
+ */
+static inline int asif_parse_header(ASIFHeader *h, const uint8_t *buf, size_t size){
+  uint32_t tag;
+
+  if (size < ASIF_V1_HEADER_SIZE)
+    return ASIF_ERR_TRUNCATED;
+
+  tag            = asif_rl32(buf);
+  h->sample_rate = asif_rl32(buf + 4);
+  h->channels    = asif_rl16(buf + 8);
+  h->nb_samples  = asif_rl32(buf + 10);
+  h->block_size  = 0;
+  h->flags       = 0;
+
+  if (tag != ASIF_TAG && tag != ASIF_V2_TAG)
+    return ASIF_ERR_INVALID;
+  if (!h->sample_rate || h->sample_rate > INT32_MAX || !h->channels)
+    return ASIF_ERR_INVALID;
+
+  if (tag == ASIF_TAG) {
+    h->version = 1;
+    h->size    = ASIF_V1_HEADER_SIZE;
+    return 0;
+  }
+
+  if (size < ASIF_V2_HEADER_SIZE)
+    return ASIF_ERR_TRUNCATED;
+  h->version    = 2;
+  h->size       = ASIF_V2_HEADER_SIZE;
+  h->block_size = asif_rl32(buf + 14);
+  h->flags      = asif_rl16(buf + 18);
+  if (!h->block_size || h->block_size > ASIF_MAX_BLOCK_SIZE)
+    return ASIF_ERR_INVALID;
+  return 0;
+}
+
+/*
+ * Limits the difference between the next sample and the current one to
+ * what a delta can hold. The encoder adds the clamped delta to its copy of
+ * the signal, so later deltas catch up with the input.
+ */
+static inline int asif_clamp_delta(int delta){
+  if (delta > 127)
+    return 127;
+  if (delta < -128)
+    return -128;
+  return delta;
+}
+
+/*
+ * Rebuilds len samples from their deltas, starting from the sample before
+ * them (0 for the start of a channel). Returns the last sample.
+ */
+static inline uint8_t asif_decode_run(uint8_t *dst, const uint8_t *deltas, size_t len, uint8_t sample){
+  for (size_t i = 0; i < len; i++){
+    sample += deltas[i];
+    dst[i] = sample;
+  }
+  return sample;
+}
+
+#endif /* AVCODEC_ASIF_H */
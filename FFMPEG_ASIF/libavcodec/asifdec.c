@@ -6,86 +6,430 @@
  */
 
 #include <inttypes.h>
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/samplefmt.h"
 #include "avcodec.h"
 #include <stdio.h>
-#include "bytestream.h"
 #include "decode.h"
+#include "get_bits.h"
+#include "golomb.h"
 #include "internal.h"
+#include "asif.h"
+#include "asifdsp.h"
 
 /*
- * Takes the sample and delta information in ASIF files and 
+ * Frames with channels at least twice this long are split into chunks that
+ * are decoded in parallel. With slice threads, frames of long packets are
+ * made about thread_count chunks long, so each thread gets one.
+ */
+#define MIN_CHUNK_SIZE (1 << 16)
+
+typedef struct ASIFDecodeContext {
+  const AVClass *class;
+  int version; // 1 = one packet for the whole file, 2 = one packet per block
+  int flags; // ASIF_FLAG_*, from the extradata
+  int frame_samples; // samples per channel in each output frame, 0 = whole packet
+  ASIFDSPContext dsp;
+
+  // the packet being turned into frames
+  AVPacket *pkt;
+  const uint8_t *deltas; // start of the first channel's deltas in the packet
+  int channel_size; // samples per channel in the packet
+  int offset; // samples per channel already output from the packet
+  uint8_t *last_sample; // last sample output for each channel
+  unsigned int last_sample_size;
+  uint8_t *unpacked; // deltas of an entropy coded block
+  unsigned int unpacked_size;
+
+  // state shared with the slice threads while a frame is decoded
+  int chunk_size, nb_chunks;
+  uint8_t *chunk_start; // sample before each chunk, one entry per chunk per channel
+  unsigned int chunk_start_size;
+} ASIFDecodeContext;
+
+/*
+ * Rebuilds len samples from their deltas, starting from the sample
+ * before them. Returns the last sample.
+ */
+static uint8_t decode_run_u8(ASIFDecodeContext *s, uint8_t *output, const uint8_t *deltas,
+                             int len, uint8_t sample){
+  int simd_len = len & ~31; // the DSP function works on multiples of 32
+
+  sample = s->dsp.prefix_sum(output, deltas, simd_len, sample);
+
+  return asif_decode_run(output + simd_len, deltas + simd_len, len - simd_len, sample);
+}
+
+/*
+ * Same as decode_run_u8, but removes the 128 bias and widens each sample
+ * to 16 bits as it is rebuilt. stride is 1 for planar output and the
+ * number of channels for interleaved output.
+ */
+static uint8_t decode_run_s16(int16_t *output, int stride, const uint8_t *deltas,
+                              int len, uint8_t sample){
+  for (int i = 0; i < len; i++){
+    sample += deltas[i];
+    output[i * stride] = (sample - 128) * 256;
+  }
+  return sample;
+}
+
+/*
+ * Same as decode_run_s16, but scales each sample to [-1.0, 1.0).
+ */
+static uint8_t decode_run_flt(float *output, int stride, const uint8_t *deltas,
+                              int len, uint8_t sample){
+  for (int i = 0; i < len; i++){
+    sample += deltas[i];
+    output[i * stride] = (sample - 128) * (1.0f / 128);
+  }
+  return sample;
+}
+
+/*
+ * Rebuilds len samples of one channel, starting at sample start of the
+ * frame, in whichever sample format was requested.
+ */
+static uint8_t decode_run(ASIFDecodeContext *s, AVFrame *frame, int channel, int start,
+                          const uint8_t *deltas, int len, uint8_t sample){
+  int channels = frame->channels;
+
+  switch (frame->format) {
+  case AV_SAMPLE_FMT_S16P:
+    return decode_run_s16((int16_t *)frame->extended_data[channel] + start, 1, deltas, len, sample);
+  case AV_SAMPLE_FMT_S16:
+    return decode_run_s16((int16_t *)frame->data[0] + (size_t)start * channels + channel,
+                          channels, deltas, len, sample);
+  case AV_SAMPLE_FMT_FLTP:
+    return decode_run_flt((float *)frame->extended_data[channel] + start, 1, deltas, len, sample);
+  case AV_SAMPLE_FMT_FLT:
+    return decode_run_flt((float *)frame->data[0] + (size_t)start * channels + channel,
+                          channels, deltas, len, sample);
+  default:
+    return decode_run_u8(s, frame->extended_data[channel] + start, deltas, len, sample);
+  }
+}
+
+/*
+ * Returns where the deltas of the given channel and frame position are
+ * in the packet.
+ */
+static const uint8_t *channel_deltas(ASIFDecodeContext *s, int channel, int start){
+  return s->deltas + (size_t)channel * s->channel_size + s->offset + start;
+}
+
+/*
+ * Slice thread job: adds up the deltas of one chunk of the frame (arg).
+ * Since the sum wraps modulo 256 it does not depend on any earlier chunk.
+ */
+static int sum_chunk(AVCodecContext *avctx, void *arg, int jobnr, int threadnr){
+  ASIFDecodeContext *s = avctx->priv_data;
+  AVFrame *frame = arg;
+  int c = jobnr / s->nb_chunks, start = (jobnr % s->nb_chunks) * s->chunk_size;
+  int len = FFMIN(s->chunk_size, frame->nb_samples - start);
+  const uint8_t *deltas = channel_deltas(s, c, start);
+  unsigned sum = 0;
+
+  for (int i = 0; i < len; i++)
+    sum += deltas[i];
+
+  s->chunk_start[jobnr] = sum;
+  return 0;
+}
+
+/*
+ * Slice thread job: decodes one chunk of the frame (arg) in its sample
+ * format, starting from the sample before the chunk.
+ */
+static int decode_chunk(AVCodecContext *avctx, void *arg, int jobnr, int threadnr){
+  ASIFDecodeContext *s = avctx->priv_data;
+  AVFrame *frame = arg;
+  int c = jobnr / s->nb_chunks, start = (jobnr % s->nb_chunks) * s->chunk_size;
+  int len = FFMIN(s->chunk_size, frame->nb_samples - start);
+
+  decode_run(s, frame, c, start, channel_deltas(s, c, start), len, s->chunk_start[jobnr]);
+  return 0;
+}
+
+/*
+ * Decodes a frame as a parallel prefix scan: the sum of every chunk is
+ * found in parallel, a scan over those sums from each channel's last
+ * sample gives the sample before each chunk, and then the chunks are
+ * written into the frame in parallel. Only the frame is decoded, so the
+ * first one comes out without waiting for the rest of the packet.
+ */
+static int decode_frame_parallel(AVCodecContext *avctx, AVFrame *frame){
+  ASIFDecodeContext *s = avctx->priv_data;
+  int nb_jobs;
+  uint8_t sample, chunk_sum;
+
+  s->nb_chunks  = FFMIN(avctx->thread_count, frame->nb_samples / MIN_CHUNK_SIZE);
+  s->chunk_size = FFALIGN((frame->nb_samples + s->nb_chunks - 1) / s->nb_chunks, 32);
+  s->nb_chunks  = (frame->nb_samples + s->chunk_size - 1) / s->chunk_size;
+  nb_jobs       = s->nb_chunks * avctx->channels;
+
+  av_fast_malloc(&s->chunk_start, &s->chunk_start_size, nb_jobs);
+  if (!s->chunk_start)
+    return AVERROR(ENOMEM);
+
+  avctx->execute2(avctx, sum_chunk, frame, NULL, nb_jobs);
+
+  // turn the chunk sums into the sample each chunk starts from
+  for (int c = 0; c < avctx->channels; c++){
+    sample = s->last_sample[c];
+    for (int i = c * s->nb_chunks; i < (c + 1) * s->nb_chunks; i++){
+      chunk_sum = s->chunk_start[i];
+      s->chunk_start[i] = sample;
+      sample += chunk_sum;
+    }
+    s->last_sample[c] = sample;
+  }
+
+  avctx->execute2(avctx, decode_chunk, frame, NULL, nb_jobs);
+  return 0;
+}
+
+/*
+ * Takes the sample and delta information in ASIF files and
  * recalculates the samples accordingly
+ *
+ * The frame continues each channel from the last sample output for it.
  */
-static void decode_deltas(const uint8_t *deltas, AVFrame *frame);
-
-static void decode_deltas(const uint8_t *deltas, AVFrame *frame){
-  int i, pos;
-  uint8_t sample; // initial sample which we use to calculate next samples
-  uint8_t *output;
-  
-  pos = 0;
-
-  for(int c = 0; c < frame->channels; c++){ // go through each channel
-    output = frame->extended_data[c]; 
-    sample = deltas[pos];
-    output[0] = sample;
-
-    for (i = 1; i < frame->nb_samples; i++){
-      output[i] = sample + deltas[pos + i]; 
-      sample += deltas[pos + i];
-     }
-    pos += frame->nb_samples; // increment the offset
+static int decode_deltas(AVCodecContext *avctx, AVFrame *frame);
+
+static int decode_deltas(AVCodecContext *avctx, AVFrame *frame){
+  ASIFDecodeContext *s = avctx->priv_data;
+
+  if (avctx->thread_count >= 2 && frame->nb_samples >= 2 * MIN_CHUNK_SIZE)
+    return decode_frame_parallel(avctx, frame);
+
+  for(int c = 0; c < frame->channels; c++) // go through each channel
+    s->last_sample[c] = decode_run(s, frame, c, 0, channel_deltas(s, c, 0),
+                                   frame->nb_samples, s->last_sample[c]);
+  return 0;
+}
+
+/*
+ * Reads the layout version from the extradata the demuxer exported, and
+ * picks the output sample format. Wider formats are written directly by
+ * the delta decoding instead of in a separate conversion pass.
+ */
+static av_cold int asif_decode_init(AVCodecContext *avctx)
+{
+  ASIFDecodeContext *s = avctx->priv_data;
+
+  s->version = 1;
+  if (avctx->extradata_size >= ASIF_EXTRADATA_SIZE) {
+    s->version = AV_RL16(avctx->extradata);
+    s->flags   = AV_RL16(avctx->extradata + 2);
+  }
+
+  if (s->version != 1 && s->version != 2) {
+    av_log(avctx, AV_LOG_ERROR, "Unsupported ASIF version %d\n", s->version);
+    return AVERROR_PATCHWELCOME;
+  }
+  if (avctx->channels <= 0)
+    return AVERROR_INVALIDDATA;
+
+  s->pkt = av_packet_alloc();
+  if (!s->pkt)
+    return AVERROR(ENOMEM);
+
+  switch (avctx->request_sample_fmt) {
+  case AV_SAMPLE_FMT_S16P:
+  case AV_SAMPLE_FMT_S16:
+  case AV_SAMPLE_FMT_FLTP:
+  case AV_SAMPLE_FMT_FLT:
+    avctx->sample_fmt = avctx->request_sample_fmt;
+    break;
+  default:
+    avctx->sample_fmt = AV_SAMPLE_FMT_U8P;
   }
+
+  ff_asifdsp_init(&s->dsp);
+  return 0;
 }
 
 /*
- * Takes the data from the AVPacket and converts it from delta form to
- * sample form, and puts it in the frame.
+ * Entropy decodes a version 2 block into plain deltas, so the rest of the
+ * decoder (output formats, frame splitting, slice threads) stays the same.
+ */
+static int unpack_rice_block(AVCodecContext *avctx)
+{
+  ASIFDecodeContext *s = avctx->priv_data;
+  GetBitContext gb;
+  uint8_t *deltas;
+  int n, k, u, ret;
+
+  if (s->pkt->size < 4)
+    return AVERROR_INVALIDDATA;
+  n = AV_RL32(s->pkt->data); // samples per channel
+  if (n <= 0 || n > ASIF_MAX_BLOCK_SIZE)
+    return AVERROR_INVALIDDATA;
+
+  av_fast_malloc(&s->unpacked, &s->unpacked_size, (size_t)n * avctx->channels);
+  if (!s->unpacked)
+    return AVERROR(ENOMEM);
+
+  if ((ret = init_get_bits8(&gb, s->pkt->data + 4, s->pkt->size - 4)) < 0)
+    return ret;
+
+  for (int c = 0; c < avctx->channels; c++) {
+    deltas = s->unpacked + (size_t)c * n;
+    deltas[0] = get_bits(&gb, 8); // the initial sample
+    k = get_bits(&gb, 4);
+    if (k > ASIF_RICE_RAW)
+      return AVERROR_INVALIDDATA;
+
+    for (int i = 1; i < n; i++) {
+      if (k == ASIF_RICE_RAW) {
+        deltas[i] = get_bits(&gb, 8);
+      } else {
+        u = get_ur_golomb(&gb, k, ASIF_RICE_LIMIT, ASIF_RICE_ESC_LEN);
+        deltas[i] = (u >> 1) ^ -(u & 1); // undo the zigzag mapping
+      }
+    }
+    if (get_bits_left(&gb) < 0)
+      return AVERROR_INVALIDDATA;
+  }
+
+  s->deltas       = s->unpacked;
+  s->channel_size = n;
+  return 0;
+}
+
+/*
+ * Finds the deltas in a new packet. The demuxer has already read the
+ * header, so a packet is just the deltas: a version 2 block, or the whole
+ * of a version 1 file. Entropy coded blocks are unpacked first.
  */
-static int asif_decode_frame(AVCodecContext *avctx, void *outdata,
-                            int *got_frame_ptr, AVPacket *pkt)
+static int parse_packet(AVCodecContext *avctx)
 {
+  ASIFDecodeContext *s = avctx->priv_data;
+  AVPacket *pkt = s->pkt;
   int ret;
-  const uint8_t *buf = pkt->data;
-  AVFrame *frame = outdata;
 
-  // read the tag asif
-  if(buf[0] != 'a' || buf[1] != 's' || buf[2] != 'i' || buf[3] != 'f'){
-    return AVERROR(EINVAL);
+  if (s->flags & ASIF_FLAG_RICE) {
+    if ((ret = unpack_rice_block(avctx)) < 0)
+      return ret;
+  } else {
+    if (pkt->size % avctx->channels)
+      return AVERROR_INVALIDDATA;
+    s->deltas       = pkt->data;
+    s->channel_size = pkt->size / avctx->channels;
   }
 
-  buf += 4; // move past the tag
+  // every channel starts with an absolute sample, added to 0 like a delta
+  av_fast_malloc(&s->last_sample, &s->last_sample_size, avctx->channels);
+  if (!s->last_sample)
+    return AVERROR(ENOMEM);
+  memset(s->last_sample, 0, avctx->channels);
+
+  s->offset = 0;
+  return 0;
+}
+
+/*
+ * Takes the data from the AVPacket and converts it from delta form to
+ * sample form, and puts it in the frame. Each packet is output as a series
+ * of frames of at most frame_samples samples, so they can be passed on
+ * before the rest of the packet is decoded.
+ */
+static int asif_receive_frame(AVCodecContext *avctx, AVFrame *frame)
+{
+  ASIFDecodeContext *s = avctx->priv_data;
+  int64_t max_samples = s->frame_samples;
+  int ret;
 
-  // read header and set the parameters for the frames
-  frame->sample_rate = bytestream_get_le32(&buf);
-  frame->channels    = bytestream_get_le16(&buf);
-  frame->nb_samples  = bytestream_get_le32(&buf);
+  while (s->offset >= s->channel_size) { // the current packet is used up
+    av_packet_unref(s->pkt);
+    s->channel_size = s->offset = 0;
 
-  // set avctx parameters
-  avctx->codec_id   = AV_CODEC_ID_ASIF;
-  avctx->sample_fmt = AV_SAMPLE_FMT_U8P;
-  avctx->codec_type = AVMEDIA_TYPE_AUDIO;
-  avctx->sample_rate = frame->sample_rate;
-  avctx->channels = frame->channels;
+    if ((ret = ff_decode_get_packet(avctx, s->pkt)) < 0)
+      return ret;
+    if ((ret = parse_packet(avctx)) < 0) {
+      av_packet_unref(s->pkt);
+      s->channel_size = 0;
+      return ret;
+    }
+  }
 
-  ret = ff_get_buffer(avctx, frame, 0);
+  frame->channels   = avctx->channels;
+  frame->nb_samples = s->channel_size - s->offset;
+  if (max_samples && avctx->thread_count >= 2) // a chunk for each slice thread
+    max_samples = FFMAX(max_samples, (int64_t)avctx->thread_count * MIN_CHUNK_SIZE);
+  if (max_samples)
+    frame->nb_samples = FFMIN(frame->nb_samples, max_samples);
 
-  if (ret < 0)
+  if ((ret = ff_get_buffer(avctx, frame, 0)) < 0)
     return ret;
 
   // decode deltas, write them into the frame
-  decode_deltas(buf, frame);
-  
-  *got_frame_ptr = 1;
+  if ((ret = decode_deltas(avctx, frame)) < 0)
+    return ret;
+
+  if (s->pkt->pts != AV_NOPTS_VALUE && avctx->pkt_timebase.num)
+    frame->pts = s->pkt->pts + av_rescale_q(s->offset, (AVRational){ 1, avctx->sample_rate },
+                                            avctx->pkt_timebase);
 
-  return pkt->size;
+  s->offset += frame->nb_samples;
+  return 0;
 }
 
+/*
+ * Drops the rest of the current packet, e.g. after a seek.
+ */
+static void asif_decode_flush(AVCodecContext *avctx)
+{
+  ASIFDecodeContext *s = avctx->priv_data;
+
+  av_packet_unref(s->pkt);
+  s->channel_size = s->offset = 0;
+}
+
+static av_cold int asif_decode_close(AVCodecContext *avctx)
+{
+  ASIFDecodeContext *s = avctx->priv_data;
+
+  av_packet_free(&s->pkt);
+  av_freep(&s->last_sample);
+  s->last_sample_size = 0;
+  av_freep(&s->unpacked);
+  s->unpacked_size = 0;
+  av_freep(&s->chunk_start);
+  s->chunk_start_size = 0;
+  return 0;
+}
+
+#define OFFSET(x) offsetof(ASIFDecodeContext, x)
+#define FLAGS AV_OPT_FLAG_AUDIO_PARAM | AV_OPT_FLAG_DECODING_PARAM
+static const AVOption options[] = {
+  { "frame_samples", "samples per channel in each output frame (0 = one frame per packet)",
+    OFFSET(frame_samples), AV_OPT_TYPE_INT, { .i64 = 4096 }, 0, INT_MAX, FLAGS },
+  { NULL },
+};
+
+static const AVClass asif_decoder_class = {
+  .class_name = "ASIF decoder",
+  .item_name  = av_default_item_name,
+  .option     = options,
+  .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVCodec ff_asif_decoder = {
   .id             = AV_CODEC_ID_ASIF,
   .type           = AVMEDIA_TYPE_AUDIO,
   .name           = "asif",
   .long_name      = NULL_IF_CONFIG_SMALL("ASIF audio file (CS 3505 Spring 20202)"),
-  .decode         = asif_decode_frame,
-  .sample_fmts    = (const enum AVSampleFormat[]) {AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_NONE},
+  .priv_data_size = sizeof(ASIFDecodeContext),
+  .init           = asif_decode_init,
+  .close          = asif_decode_close,
+  .receive_frame  = asif_receive_frame,
+  .flush          = asif_decode_flush,
+  .capabilities   = AV_CODEC_CAP_SLICE_THREADS,
+  .sample_fmts    = (const enum AVSampleFormat[]) {AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_S16P,
+                                                     AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLTP,
+                                                     AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_NONE},
+  .priv_class     = &asif_decoder_class,
 };
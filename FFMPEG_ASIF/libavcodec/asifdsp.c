@@ -0,0 +1,45 @@
+/*
+ * ASIF DSP functions
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "asif.h"
+#include "asifdsp.h"
+
+/*
+ * Plain C version of the delta prefix sum. Each sample depends on the one
+ * before it, so this runs one byte at a time.
+ */
+static uint8_t prefix_sum_c(uint8_t *dst, const uint8_t *src, ptrdiff_t len, int prev){
+  return asif_decode_run(dst, src, len, prev);
+}
+
+/*
+ * Plain C version of the clamp-free delta generation, 32 samples at a time.
+ */
+static int gen_deltas_c(uint8_t *dst, const uint8_t *src, ptrdiff_t len){
+  int delta;
+
+  for (ptrdiff_t done = 0; done < len; done += 32){
+    for (int i = 0; i < 32; i++){
+      delta = src[done + i] - src[done + i - 1];
+      if (delta > 127 || delta < -128)
+        return done;
+    }
+    for (int i = 0; i < 32; i++)
+      dst[done + i] = src[done + i] - src[done + i - 1];
+  }
+  return len;
+}
+
+av_cold void ff_asifdsp_init(ASIFDSPContext *c){
+  c->prefix_sum = prefix_sum_c;
+  c->gen_deltas = gen_deltas_c;
+
+  if (ARCH_X86)
+    ff_asifdsp_init_x86(c);
+}
@@ -0,0 +1,38 @@
+/*
+ * ASIF DSP functions
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#ifndef AVCODEC_ASIFDSP_H
+#define AVCODEC_ASIFDSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ASIFDSPContext {
+  /*
+   * Rebuilds samples from deltas: dst[i] = prev + src[0] + ... + src[i],
+   * wrapping modulo 256. An initial sample can be passed as the first
+   * delta with prev = 0.
+   * @param len number of samples, must be a multiple of 32
+   * @return the last sample written, or prev if len is 0
+   */
+  uint8_t (*prefix_sum)(uint8_t *dst, const uint8_t *src, ptrdiff_t len, int prev);
+
+  /*
+   * Writes the deltas dst[i] = src[i] - src[i - 1] as long as none of them
+   * has to be clamped to [-128, 127], so they are only valid when src[-1]
+   * is also the last reconstructed sample. Stops at the first group of
+   * samples that needs clamping; src[-1] must be readable.
+   * @param len number of samples, must be a multiple of 32
+   * @return how many of the leading samples were written
+   */
+  int (*gen_deltas)(uint8_t *dst, const uint8_t *src, ptrdiff_t len);
+} ASIFDSPContext;
+
+void ff_asifdsp_init(ASIFDSPContext *c);
+void ff_asifdsp_init_x86(ASIFDSPContext *c);
+
+#endif /* AVCODEC_ASIFDSP_H */
@@ -5,9 +5,16 @@
  * April 20, 2020
  */
 
+#include "libavutil/opt.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/samplefmt.h"
 #include "avcodec.h"
 #include "internal.h"
 #include "bytestream.h"
+#include "put_bits.h"
+#include "golomb.h"
+#include "asif.h"
+#include "asifdsp.h"
 #include "../libavformat/avio.h"
 
 /*
@@ -15,9 +22,8 @@
  * info received from the AVFrames
  */
 typedef struct asif_node{
-  uint8_t *data[16]; // each entry in the array is a pointer to channel data
+  AVFrame *frame; // reference to the frame, its extended_data holds each channel's samples
   struct asif_node *next;
-  int num_samples; // keep track of number of samples for each frame
 } asif_node;
 
 
@@ -25,99 +31,383 @@ typedef struct asif_node{
  * The private data utilized by the encoder 
  */
 typedef struct asif_encode_data{
+  const AVClass *class;
+  int version; // 1 = deltas for the whole file, 2 = blocks with resync points
+  int block_size; // samples per channel in each version 2 block
+  int dither; // add triangular noise when quantizing wide input to 8 bits
+  unsigned *dither_seed; // each channel's noise generator, carried from one block to the next
+  int rice; // entropy code the version 2 blocks
+  uint8_t *block_deltas; // a block's plain deltas, before they are entropy coded
+  unsigned int block_deltas_size;
+  enum AVSampleFormat sample_fmt;
   int num_channels;
   int total_samples; 
   int drained;
   int received_all_frames, draining;
+  int short_frame; // a version 2 frame had fewer than block_size samples, so it must be the last
   asif_node *head; // keep track of the head of the linked list
+  asif_node *tail; // and of its end, so frames are appended in constant time
+  ASIFDSPContext dsp;
 } asif_encode_data;
 
+/*
+ * Where the channels' deltas go in the packet, shared with the slice threads
+ */
+typedef struct asif_channel_job{
+  uint8_t *data; // start of the first channel's deltas
+  int channel_size; // number of samples per channel in the packet
+} asif_channel_job;
+
 /*
  * Method Declarations
  */
 static asif_node* add_asif_node(asif_encode_data *pd);
+static void free_asif_node(asif_node *node);
 static void gen_deltas (asif_encode_data *pd, uint8_t* deltas, int channel_number);
+static int encode_channel(AVCodecContext *avctx, void *arg, int channel, int threadnr);
+static int encode_block(AVCodecContext *avctx, AVPacket *avpkt);
 
 /*
- * Adds an asif_node to the linked list containing audio data.
- * Returns a pointer to the new node that was added.
+ * Adds an asif_node to the end of the linked list containing audio data.
+ * Returns a pointer to the new node that was added, or NULL if out of memory.
  */ 
 static asif_node* add_asif_node(asif_encode_data *pd){
 
-  asif_node *curr, *prev;
-  
-  if (pd->head == NULL){ // add the first node to the linked list
-    pd->head = (asif_node*) av_mallocz(sizeof(asif_node));
-    return pd->head;
+  asif_node *curr = (asif_node*) av_mallocz(sizeof(asif_node));
+
+  if (!curr)
+    return NULL;
+
+  if (pd->head == NULL) // add the first node to the linked list
+    pd->head = curr;
+  else
+    pd->tail->next = curr;
+  pd->tail = curr;
+
+  return curr;
+}
+
+/*
+ * Releases a node and its reference to the frame.
+ */
+static void free_asif_node(asif_node *node){
+  av_frame_free(&node->frame);
+  av_free(node);
+}
+
+/*
+ * Quantizes one wide input sample to unsigned 8 bits. Without dither this
+ * matches what libswresample does, so the output is the same as when the
+ * input was converted to U8P before encoding.
+ */
+static av_always_inline uint8_t quantize(enum AVSampleFormat fmt, const uint8_t *samples, int i,
+                                         int dither, unsigned *seed){
+  int noise = 0;
+
+  if (dither){ // triangular noise of up to one output step, in 1/256 steps
+    *seed = *seed * 1664525 + 1013904223;
+    noise = *seed >> 24;
+    *seed = *seed * 1664525 + 1013904223;
+    noise -= *seed >> 24;
   }
 
-  curr = pd->head;
-  while(curr){
-    prev = curr;
-    curr = curr->next;
+  if (fmt == AV_SAMPLE_FMT_S16P || fmt == AV_SAMPLE_FMT_S16){
+    if (!dither)
+      return (((const int16_t *) samples)[i] >> 8) + 128;
+    return av_clip_uint8(((((const int16_t *) samples)[i] + noise + 128) >> 8) + 128);
   }
-  curr = (asif_node*) av_mallocz(sizeof(asif_node));
+  return av_clip_uint8(lrintf(((const float *) samples)[i] * 128 + noise * (1.0f / 256)) + 128);
+}
+
+/*
+ * Same as gen_deltas, but for S16P/S16/FLTP/FLT input: every sample is
+ * quantized to 8 bits right where its delta is computed, so no 8-bit copy
+ * of the audio is ever made.
+ */
+static av_always_inline void gen_deltas_wide(asif_encode_data *pd, uint8_t* deltas, int channel_number,
+                                             enum AVSampleFormat fmt){
+  int i, pos, curr_delta;
+  int planar = fmt == AV_SAMPLE_FMT_S16P || fmt == AV_SAMPLE_FMT_FLTP;
+  int bytes = av_get_bytes_per_sample(fmt);
+  int stride = planar ? 1 : pd->num_channels; // packed input is interleaved
+  unsigned seed = pd->dither_seed[channel_number]; // only this channel's job touches it
+  uint8_t curr_sample;
+  const uint8_t *samples;
+  asif_node *curr;
 
-  if (prev) // if there is a node before the new node
-    prev->next = curr;
+  curr = pd->head;
+  pos = 0;
+  i = 1;
 
-  curr->next = NULL;
+  samples = planar ? curr->frame->extended_data[channel_number] : curr->frame->data[0] + channel_number * bytes;
+  deltas[0] = quantize(fmt, samples, 0, pd->dither, &seed); // the initial sample
+  curr_sample = deltas[0];
 
-  return curr;
+  while (curr) { // go through the data obtained from the frames
+    samples = planar ? curr->frame->extended_data[channel_number] : curr->frame->data[0] + channel_number * bytes;
+
+    for (; i < curr->frame->nb_samples; i++){
+      curr_delta = (int) quantize(fmt, samples, i * stride, pd->dither, &seed) - (int) curr_sample;
+      curr_delta = asif_clamp_delta(curr_delta);
+
+      deltas[i + pos] = (uint8_t) curr_delta;
+      curr_sample = curr_sample + curr_delta;
+    }
+    pos += curr->frame->nb_samples; // offset to write in info from next node/frame
+    curr = curr->next; // move to next node/frame
+    i = 0;
+  }
+  pd->dither_seed[channel_number] = seed; // the next block continues the noise
 }
 
 /*
  *Writes in an initial sample and corresponding deltas based on the initial sample.
  *@param deltas -- size of deltas will be size of one channel
+ *
+ * While the reconstructed signal matches the input, the deltas are plain
+ * differences between neighbouring samples, so runs that need no clamping
+ * are written in bulk by the DSP function. Only groups that need clamping
+ * go through the sample-by-sample loop, until the signal catches up again.
  */
 static void gen_deltas(asif_encode_data *pd, uint8_t* deltas, int channel_number){
-  int i, pos;
+  int i, pos, end;
   uint8_t curr_sample;
+  uint8_t *samples;
   int curr_delta;
   asif_node *curr;
+
+  switch (pd->sample_fmt) { // wide input is quantized on the fly
+  case AV_SAMPLE_FMT_S16P:
+    gen_deltas_wide(pd, deltas, channel_number, AV_SAMPLE_FMT_S16P);
+    return;
+  case AV_SAMPLE_FMT_S16:
+    gen_deltas_wide(pd, deltas, channel_number, AV_SAMPLE_FMT_S16);
+    return;
+  case AV_SAMPLE_FMT_FLTP:
+    gen_deltas_wide(pd, deltas, channel_number, AV_SAMPLE_FMT_FLTP);
+    return;
+  case AV_SAMPLE_FMT_FLT:
+    gen_deltas_wide(pd, deltas, channel_number, AV_SAMPLE_FMT_FLT);
+    return;
+  default: // U8P is used as it is
+    break;
+  }
  
-  deltas[0] = pd->head->data[channel_number][0]; // the initial sample
+  deltas[0] = pd->head->frame->extended_data[channel_number][0]; // the initial sample
   curr_sample = deltas[0];
   curr = pd->head;
   pos = 0; // initial offset is 0 (start writing at the beginning of the array)
   i = 1;
 
   while (curr) { // go through the data obtained from the frames
-    for (; i < curr->num_samples; i++){
-     
-      // generate deltas based on consecutive samples
-      curr_delta = (int) curr->data[channel_number][i] - (int) curr_sample; 
+    samples = curr->frame->extended_data[channel_number];
 
-      // clamp the value
-      if (curr_delta > 127){
-	curr_delta = 127;
-      }
-      else if (curr_delta < -128){
-	curr_delta = -128;
+    while (i < curr->frame->nb_samples){
+
+      // no clamping so far, so try the fast path for the rest of the frame
+      if (i > 0 && curr_sample == samples[i - 1]){
+        i += pd->dsp.gen_deltas(deltas + pos + i, samples + i, (curr->frame->nb_samples - i) & ~31);
+        curr_sample = samples[i - 1];
       }
+
+      end = FFMIN(i + 32, curr->frame->nb_samples);
+      for (; i < end; i++){
+     
+        // generate deltas based on consecutive samples
+        curr_delta = (int) samples[i] - (int) curr_sample; 
+        curr_delta = asif_clamp_delta(curr_delta);
       
-      // place the delta in its place in the array
-      deltas[i + pos] = (uint8_t) curr_delta;
-      curr_sample = curr_sample + curr_delta;
+        // place the delta in its place in the array
+        deltas[i + pos] = (uint8_t) curr_delta;
+        curr_sample = curr_sample + curr_delta;
+      }
     }
-    pos += curr->num_samples; // offset to write in info from next node/frame
+    pos += curr->frame->nb_samples; // offset to write in info from next node/frame
     curr = curr->next; // move to next node/frame
     i = 0;
   }
 }
 
+/*
+ * Slice thread job: channels do not depend on each other, so each one
+ * writes its deltas straight into its own part of the packet.
+ */
+static int encode_channel(AVCodecContext *avctx, void *arg, int channel, int threadnr){
+
+  asif_channel_job *job = arg;
+
+  gen_deltas(avctx->priv_data, job->data + (size_t)channel * job->channel_size, channel);
+  return 0;
+}
+
+/*
+ * Maps a delta to an unsigned value, small magnitudes first: 0, -1, 1, -2, ...
+ */
+static inline int zigzag(uint8_t delta){
+  int d = (int8_t) delta;
+  return 2 * d ^ (d >> 7);
+}
+
+/*
+ * Number of bits set_ur_golomb takes for the value with parameter k.
+ */
+static inline int rice_bits(int u, int k){
+  if ((u >> k) < ASIF_RICE_LIMIT)
+    return (u >> k) + 1 + k;
+  return ASIF_RICE_LIMIT + ASIF_RICE_ESC_LEN;
+}
+
+/*
+ * Entropy codes one channel of a block. The parameter is the one that gives
+ * the fewest bits for this channel; if none beats plain bytes, plain bytes
+ * are written, so a channel never grows by more than its 12 bit preamble.
+ */
+static void rice_channel(PutBitContext *pb, const uint8_t *deltas, int n){
+  int64_t bits[ASIF_RICE_RAW] = { 0 };
+  int64_t best_bits = 8LL * (n - 1);
+  int i, k, u, best = ASIF_RICE_RAW;
+
+  for (i = 1; i < n; i++){
+    u = zigzag(deltas[i]);
+    for (k = 0; k < ASIF_RICE_RAW; k++)
+      bits[k] += rice_bits(u, k);
+  }
+  for (k = 0; k < ASIF_RICE_RAW; k++){
+    if (bits[k] < best_bits){
+      best_bits = bits[k];
+      best = k;
+    }
+  }
+
+  put_bits(pb, 8, deltas[0]); // the initial sample
+  put_bits(pb, 4, best);
+  for (i = 1; i < n; i++){
+    if (best == ASIF_RICE_RAW)
+      put_bits(pb, 8, deltas[i]);
+    else
+      set_ur_golomb(pb, zigzag(deltas[i]), best, ASIF_RICE_LIMIT, ASIF_RICE_ESC_LEN);
+  }
+}
+
+/*
+ * Writes an entropy coded version 2 block: the plain deltas are generated
+ * on the slice threads as usual, then coded one channel after the other.
+ */
+static int encode_rice_block(AVCodecContext *avctx, AVPacket *avpkt, int n){
+
+  asif_encode_data *s = avctx->priv_data;
+  asif_channel_job job;
+  PutBitContext pb;
+  int64_t max_size;
+  int ret, c;
+
+  av_fast_malloc(&s->block_deltas, &s->block_deltas_size, (size_t)n * s->num_channels);
+  if (!s->block_deltas)
+    return AVERROR(ENOMEM);
+
+  job.data = s->block_deltas;
+  job.channel_size = n;
+  avctx->execute2(avctx, encode_channel, &job, NULL, s->num_channels);
+
+  // at worst every channel is 8 + 4 bits of preamble and n - 1 plain bytes;
+  // min_size = size so the packet is refcounted, and shrunk once coded
+  max_size = 4 + (int64_t)(n + 2) * s->num_channels;
+  if ((ret = ff_alloc_packet2(avctx, avpkt, max_size, max_size)) < 0)
+    return ret;
+
+  AV_WL32(avpkt->data, n); // samples per channel
+  init_put_bits(&pb, avpkt->data + 4, avpkt->size - 4);
+  for (c = 0; c < s->num_channels; c++)
+    rice_channel(&pb, s->block_deltas + (size_t)c * n, n);
+  flush_put_bits(&pb);
+
+  av_shrink_packet(avpkt, 4 + put_bits_count(&pb) / 8);
+  return 0;
+}
+
+/*
+ * Writes one version 2 block for the frame at the head of the list, then
+ * removes that frame. Every block starts over with an absolute sample for
+ * each channel, so it can be decoded without any of the blocks before it.
+ */
+static int encode_block(AVCodecContext *avctx, AVPacket *avpkt){
+
+  asif_encode_data *s = avctx->priv_data;
+  asif_node *node = s->head;
+  asif_channel_job job;
+  int ret;
+
+  // the head node is the only one queued, so gen_deltas only sees this frame
+  if (s->rice) {
+    if ((ret = encode_rice_block(avctx, avpkt, node->frame->nb_samples)) < 0)
+      return ret;
+  } else {
+    // min_size = size so the packet is refcounted, as receive_packet needs
+    if ((ret = ff_alloc_packet2(avctx, avpkt, node->frame->nb_samples * s->num_channels,
+                                node->frame->nb_samples * s->num_channels)) < 0)
+      return ret;
+
+    job.data = avpkt->data;
+    job.channel_size = node->frame->nb_samples;
+    avctx->execute2(avctx, encode_channel, &job, NULL, s->num_channels);
+  }
+
+  avpkt->pts      = node->frame->pts;
+  avpkt->duration = node->frame->nb_samples;
+
+  s->head = node->next;
+  if (!s->head)
+    s->tail = NULL;
+  free_asif_node(node);
+
+  return 0;
+}
+
 /*
  * Sets the frame size, as well as the fields of the asif_encode_data struct.
  * Since frame_size is the number of samples per channel per frame, if there are
  * 2 channels with frame_size 1,000,000, there will be 2,000,000 samples per frame.
+ * Version 2 uses one frame per block, and describes the layout in the extradata.
+ * Entropy coding only exists in version 2, where every block stands alone.
  */
 static int asif_encode_init(AVCodecContext *avctx){ 
   
   asif_encode_data *s = avctx->priv_data;
+  uint8_t *extradata;
+
   s->total_samples = 0;
   s->received_all_frames = 0; // change to one once all frame data is collected
   s->drained = 0; // change to 1 to indicate buffer is drained
+  s->num_channels = avctx->channels; // set here too, in case no frame ever comes
   avctx->frame_size = 1000000; // number of samples per channel per frame
+  s->sample_fmt = avctx->sample_fmt;
+  ff_asifdsp_init(&s->dsp);
+
+  // each channel gets its own noise, which must not restart with every block
+  s->dither_seed = av_malloc_array(avctx->channels, sizeof(*s->dither_seed));
+  if (!s->dither_seed)
+    return AVERROR(ENOMEM);
+  for (int c = 0; c < avctx->channels; c++)
+    s->dither_seed[c] = c;
+
+  if (s->rice && s->version != 2) {
+    av_log(avctx, AV_LOG_ERROR, "Entropy coding needs asif_version 2\n");
+    return AVERROR(EINVAL);
+  }
+
+  if (s->version == 2) {
+    avctx->frame_size = s->block_size;
+
+    avctx->extradata = av_mallocz(ASIF_EXTRADATA_SIZE + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!avctx->extradata)
+      return AVERROR(ENOMEM);
+    avctx->extradata_size = ASIF_EXTRADATA_SIZE;
+
+    extradata = avctx->extradata;
+    bytestream_put_le16(&extradata, s->version);
+    bytestream_put_le16(&extradata, s->rice ? ASIF_FLAG_RICE : 0); // flags
+    bytestream_put_le32(&extradata, s->block_size);
+  }
  
   return 0;
 }
@@ -125,15 +415,35 @@ static int asif_encode_init(AVCodecContext *avctx){
 /*
  * FFMPEG calls this to send the decoded audio frames to the encoder. 
  * Since the frames are in a planar format, must use frame->extended_data.
+ * Packed frames only have one plane, holding all the channels.
+ * The frame's buffers are referenced rather than copied. Each version 2
+ * frame becomes one block, so it must hold exactly block_size samples,
+ * except for the last one.
  */
 static int asif_send_frame (AVCodecContext *avctx, const AVFrame *frame){
  
   asif_encode_data *s;
   asif_node *new_node = NULL;
+  AVFrame *ref;
 
   s = avctx->priv_data;
   s->draining = 0;
 
+  // a flush is always taken: the queued block still comes out before EOF,
+  // and libavcodec would not pass a second flush on to the encoder
+  if (s->version == 2 && frame && s->head) // the previous block has not been taken yet
+    return AVERROR(EAGAIN);
+
+  // the seek index assumes every block but the last holds block_size samples
+  if (s->version == 2 && frame) {
+    if (frame->nb_samples > s->block_size || s->short_frame) {
+      av_log(avctx, AV_LOG_ERROR, "Version 2 frames must have %d samples, only the last may be shorter\n",
+             s->block_size);
+      return AVERROR(EINVAL);
+    }
+    s->short_frame = frame->nb_samples < s->block_size;
+  }
+
   if (!frame) { // if frame is null
     s->draining = 1;
     if (s->draining){
@@ -149,15 +459,16 @@ static int asif_send_frame (AVCodecContext *avctx, const AVFrame *frame){
       // increment number of total samples found for each frame
       s->total_samples += frame->nb_samples * frame->channels;
        
-      new_node = add_asif_node(s); // add the node to the existing list
-      new_node->num_samples = frame->nb_samples;
+      ref = av_frame_clone(frame); // a new reference to the same buffers
+      if (!ref)
+        return AVERROR(ENOMEM);
 
-      for(int c = 0; c < s->num_channels; c++){
-	new_node->data[c] = av_memdup(frame->extended_data[c], new_node->num_samples);
+      new_node = add_asif_node(s); // add the node to the existing list
+      if (!new_node) {
+        av_frame_free(&ref);
+        return AVERROR(ENOMEM);
       }
-
-      if (s->head == NULL)
-	s->head = new_node;
+      new_node->frame = ref;
 
       return 0;
     }
@@ -174,38 +485,36 @@ static int asif_receive_packet(AVCodecContext *avctx, AVPacket *avpkt){
 
   asif_encode_data *s;
   int packet_size, ret, total_samples_per_channel;
-  uint8_t *beg_buf, *deltas;
+  asif_channel_job job;
 
   s = avctx->priv_data;
 
-  // + 4 bytes to account for writing part of the header
-  packet_size = s->total_samples + 4; // should be the number of total samples in the file  
+  if (s->version == 2) { // every frame becomes its own block
+    if (s->head)
+      return encode_block(avctx, avpkt);
+    return s->drained ? AVERROR_EOF : AVERROR(EAGAIN);
+  }
+
+  packet_size = s->total_samples; // should be the number of total samples in the file  
   
   if (!s->received_all_frames && s->drained) { // start collecting all the frames data
-    
+
+    if (!s->total_samples) // nothing was sent, so there are no deltas to write
+      return AVERROR_EOF;
+
     if ((ret = ff_alloc_packet2(avctx, avpkt, packet_size, packet_size)) < 0)
       return ret; // error while allocating packet
 
     total_samples_per_channel = s->total_samples / s->num_channels;
    
-    beg_buf = avpkt->data;
-
-    bytestream_put_le32(&avpkt->data, total_samples_per_channel); // write in number of samples per channel
-   
-    for (int c = 0; c < s->num_channels; c++){ // Walk through the channel's data one by one
-      
-      // allocate space for the array of deltas
-      deltas = (uint8_t*) av_mallocz(total_samples_per_channel); // size of an entire channel
-      
-      // walk through the samples, calculate deltas, and put them into the array to be copied
-      gen_deltas(s, deltas, c); 
-      // write in all the delta information to the packet
-      bytestream_put_buffer(&avpkt->data, deltas, total_samples_per_channel);
-     
-      av_free(deltas);
-    }
-
-    avpkt->data = beg_buf; // have the packet's data point to the beginning of the buffer
+    // the muxer writes the whole header, including the number of samples per channel
+    // generate every channel's deltas in place, spread over the slice threads
+    job.data = avpkt->data;
+    job.channel_size = total_samples_per_channel;
+    avctx->execute2(avctx, encode_channel, &job, NULL, s->num_channels);
+
+    avpkt->pts      = 0;
+    avpkt->duration = total_samples_per_channel;
       
     s->received_all_frames = 1; // set the flag to true
     return 0;
@@ -230,12 +539,36 @@ static int asif_encode_close(AVCodecContext *avctx){
     {
       temp = curr;
       curr = curr->next;
-      av_free(temp);
+      free_asif_node(temp);
     }
+  s->head = s->tail = NULL;
+  av_freep(&s->block_deltas);
+  av_freep(&s->dither_seed);
 
   return 0;
 }
 
+#define OFFSET(x) offsetof(asif_encode_data, x)
+#define FLAGS AV_OPT_FLAG_AUDIO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+  { "asif_version", "layout to write (1 = deltas for the whole file, 2 = seekable blocks)",
+    OFFSET(version), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 2, FLAGS },
+  { "block_size", "samples per channel in each version 2 block",
+    OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = ASIF_DEFAULT_BLOCK_SIZE }, 1, ASIF_MAX_BLOCK_SIZE, FLAGS },
+  { "dither", "add triangular dither when quantizing 16-bit or float input to 8 bits",
+    OFFSET(dither), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+  { "rice", "entropy code the deltas of each version 2 block",
+    OFFSET(rice), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+  { NULL },
+};
+
+static const AVClass asif_encoder_class = {
+  .class_name = "ASIF encoder",
+  .item_name  = av_default_item_name,
+  .option     = options,
+  .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVCodec ff_asif_encoder = {
   .id             = AV_CODEC_ID_ASIF,
   .priv_data_size = sizeof(asif_encode_data),
@@ -246,6 +579,9 @@ AVCodec ff_asif_encoder = {
   .send_frame     = asif_send_frame,
   .receive_packet = asif_receive_packet,
   .close          = asif_encode_close,
-  .sample_fmts    = (const enum AVSampleFormat[]) {AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_NONE},
-  .capabilities   = AV_CODEC_CAP_DELAY, 
+  .sample_fmts    = (const enum AVSampleFormat[]) {AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_S16P,
+                                                     AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLTP,
+                                                     AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_NONE},
+  .capabilities   = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
+  .priv_class     = &asif_encoder_class,
 };
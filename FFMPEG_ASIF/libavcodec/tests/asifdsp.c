@@ -0,0 +1,186 @@
+/*
+ * Checks every ASIF DSP implementation the CPU can run against plain C
+ * references, on random lengths and unaligned buffers, and times them.
+ *
+ * Usage: libavcodec/tests/asifdsp [seed]
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavcodec/asifdsp.h"
+
+#define MAX_LEN 4096 // samples per call, a multiple of 32
+#define TESTS 1000 // random calls checked per function
+#define RUNS 20000 // calls timed per function
+
+/*
+ * Instruction sets to try, from none up. Each level keeps only the CPU
+ * flags below the next one, so its own functions are the ones picked.
+ */
+static const struct {
+  const char *name;
+  int drop; // CPU flags taken away to stay at this level
+} levels[] = {
+  { "c",    -1 },
+  { "sse2", AV_CPU_FLAG_AVX2 },
+  { "avx2", 0 },
+};
+
+static uint8_t src_buf[MAX_LEN + 64], dst_buf[MAX_LEN + 64], ref_buf[MAX_LEN + 64];
+
+/*
+ * dst[i] = prev + src[0] + ... + src[i], one byte at a time.
+ */
+static uint8_t prefix_sum_ref(uint8_t *dst, const uint8_t *src, int len, uint8_t prev){
+  for (int i = 0; i < len; i++)
+    dst[i] = prev += src[i];
+  return prev;
+}
+
+static int check_prefix_sum(ASIFDSPContext *dsp, AVLFG *lfg, const char *name){
+  uint8_t *dst, *src, ret, ref;
+  int len, prev;
+
+  for (int t = 0; t < TESTS; t++) {
+    len  = av_lfg_get(lfg) % (MAX_LEN / 32 + 1) * 32;
+    prev = av_lfg_get(lfg) & 0xff;
+    src  = src_buf + av_lfg_get(lfg) % 32;
+    dst  = dst_buf + av_lfg_get(lfg) % 32;
+
+    for (int i = 0; i < len; i++)
+      src[i] = av_lfg_get(lfg);
+    memset(dst_buf, 0xAA, sizeof(dst_buf));
+    memset(ref_buf, 0xAA, sizeof(ref_buf));
+
+    ret = dsp->prefix_sum(dst, src, len, prev);
+    ref = prefix_sum_ref(ref_buf + (dst - dst_buf), src, len, prev);
+
+    if (ret != ref || memcmp(dst_buf, ref_buf, sizeof(dst_buf))) {
+      fprintf(stderr, "prefix_sum_%s: mismatch with len %d, prev %d\n", name, len, prev);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Fills len samples, and the one before them, with a random walk that
+ * jumps by more than a delta can hold about once every 'jump' samples.
+ */
+static void random_walk(AVLFG *lfg, uint8_t *src, int len, int jump){
+  uint8_t sample = av_lfg_get(lfg);
+
+  for (int i = -1; i < len; i++) {
+    if (!(av_lfg_get(lfg) % jump))
+      sample += 128 + av_lfg_get(lfg) % 64; // needs clamping
+    else
+      sample += av_lfg_get(lfg) % 33 - 16;
+    src[i] = sample;
+  }
+}
+
+static int needs_clamp(const uint8_t *src, int i){
+  int delta = src[i] - src[i - 1];
+  return delta > 127 || delta < -128;
+}
+
+/*
+ * gen_deltas may stop anywhere before the first sample that needs
+ * clamping, as long as it is on a 16 sample boundary (SSE2 works 16 at a
+ * time, C and AVX2 32), and only once that sample is in the next 32.
+ */
+static int check_gen_deltas(ASIFDSPContext *dsp, AVLFG *lfg, const char *name){
+  uint8_t *dst, *src;
+  int len, ret, i;
+
+  for (int t = 0; t < TESTS; t++) {
+    len = av_lfg_get(lfg) % (MAX_LEN / 32 + 1) * 32;
+    src = src_buf + 1 + av_lfg_get(lfg) % 32; // src[-1] is read
+    dst = dst_buf + av_lfg_get(lfg) % 32;
+
+    random_walk(lfg, src, len, 1 + av_lfg_get(lfg) % 2048);
+    memset(dst_buf, 0xAA, sizeof(dst_buf));
+    memset(ref_buf, 0xAA, sizeof(ref_buf));
+
+    ret = dsp->gen_deltas(dst, src, len);
+
+    for (i = 0; i < ret && i < len && !needs_clamp(src, i); i++)
+      ref_buf[dst - dst_buf + i] = src[i] - src[i - 1];
+
+    if (ret < 0 || ret > len || ret % 16 || i < ret) {
+      fprintf(stderr, "gen_deltas_%s: returned %d of %d, clamping first needed at %d\n",
+              name, ret, len, i);
+      return 1;
+    }
+    for (; i < len && i < ret + 32 && !needs_clamp(src, i); i++)
+      ;
+    if (ret < len && i == FFMIN(len, ret + 32)) {
+      fprintf(stderr, "gen_deltas_%s: stopped at %d of %d without clamping\n", name, ret, len);
+      return 1;
+    }
+    if (memcmp(dst_buf, ref_buf, sizeof(dst_buf))) {
+      fprintf(stderr, "gen_deltas_%s: wrong deltas with len %d\n", name, len);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void bench_prefix_sum(ASIFDSPContext *dsp, const char *name){
+  int64_t t = av_gettime_relative();
+  uint8_t sum = 0;
+
+  for (int r = 0; r < RUNS; r++)
+    sum += dsp->prefix_sum(dst_buf, src_buf, MAX_LEN, sum);
+  t = av_gettime_relative() - t;
+
+  printf("prefix_sum_%-4s %8.1f MB/s\n", name, t ? (double)RUNS * MAX_LEN / t : 0.0);
+}
+
+static void bench_gen_deltas(ASIFDSPContext *dsp, AVLFG *lfg, const char *name){
+  int64_t t;
+  int done = 0;
+
+  random_walk(lfg, src_buf + 1, MAX_LEN, INT_MAX); // no clamping, so the whole run is taken
+  t = av_gettime_relative();
+  for (int r = 0; r < RUNS; r++)
+    done += dsp->gen_deltas(dst_buf, src_buf + 1, MAX_LEN);
+  t = av_gettime_relative() - t;
+
+  printf("gen_deltas_%-4s %8.1f MB/s\n", name, t ? (double)done / t : 0.0);
+}
+
+int main(int argc, char **argv){
+  ASIFDSPContext dsp, prev = { 0 };
+  int cpu_flags = av_get_cpu_flags();
+  unsigned seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 0xA51F;
+  int ret = 0;
+  AVLFG lfg;
+
+  for (int l = 0; l < FF_ARRAY_ELEMS(levels); l++) {
+    av_force_cpu_flags(levels[l].drop == -1 ? 0 : cpu_flags & ~levels[l].drop);
+    ff_asifdsp_init(&dsp);
+    if (l && !memcmp(&dsp, &prev, sizeof(dsp)))
+      continue; // nothing new at this level on this CPU or build
+    prev = dsp;
+
+    av_lfg_init(&lfg, seed);
+    ret |= check_prefix_sum(&dsp, &lfg, levels[l].name);
+    ret |= check_gen_deltas(&dsp, &lfg, levels[l].name);
+    bench_prefix_sum(&dsp, levels[l].name);
+    bench_gen_deltas(&dsp, &lfg, levels[l].name);
+  }
+
+  if (!ret)
+    printf("all checks passed\n");
+  return ret;
+}
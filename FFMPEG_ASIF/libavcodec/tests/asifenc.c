@@ -0,0 +1,200 @@
+/*
+ * Encodes clamp-heavy 8-bit signals with the ASIF encoder, as version 1
+ * and version 2 and on one or several threads, and compares the output
+ * with the plain sample-by-sample closed-loop encoder, which is what the
+ * encoder did before the SIMD fast path was added.
+ *
+ * Usage: libavcodec/tests/asifenc
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavcodec/avcodec.h"
+
+#define MAX_CHANNELS 3
+
+static const struct {
+  int version, block_size, threads, channels, len;
+} tests[] = {
+  { 1,    0, 1, 2,      0 },
+  { 1,    0, 1, 1,      1 },
+  { 1,    0, 1, 2,     31 },
+  { 1,    0, 4, 3,     33 },
+  { 1,    0, 1, 3, 100003 },
+  { 1,    0, 4, 3, 100003 },
+  { 2, 4096, 1, 2,  10000 },
+  { 2, 4096, 4, 3,  20480 },
+  { 2, 1000, 4, 1,   1001 },
+  { 2,    1, 1, 2,      7 },
+  { 2, 4096, 1, 2,      0 },
+};
+
+/*
+ * The encoder as it was: every delta is clamped to what a byte holds and
+ * added to the rebuilt signal, so later deltas catch up with the input.
+ */
+static void encode_ref(uint8_t *deltas, const uint8_t *samples, int len){
+  uint8_t curr_sample = deltas[0] = samples[0];
+  int curr_delta;
+
+  for (int i = 1; i < len; i++) {
+    curr_delta = (int) samples[i] - (int) curr_sample;
+    if (curr_delta > 127)
+      curr_delta = 127;
+    else if (curr_delta < -128)
+      curr_delta = -128;
+    deltas[i] = curr_delta;
+    curr_sample += curr_delta;
+  }
+}
+
+/*
+ * Signals that clamp a lot: noise, full-scale square waves, and smooth
+ * ramps with sudden jumps, so both the fast path and the clamping loop run.
+ */
+static void gen_signal(AVLFG *lfg, uint8_t *dst, int len, int kind){
+  uint8_t sample = av_lfg_get(lfg);
+  int period = 2 + av_lfg_get(lfg) % 300;
+
+  for (int i = 0; i < len; i++) {
+    switch (kind) {
+    case 0:
+      dst[i] = av_lfg_get(lfg);
+      break;
+    case 1:
+      dst[i] = i / period & 1 ? 255 : 0;
+      break;
+    default:
+      sample += av_lfg_get(lfg) % 500 ? av_lfg_get(lfg) % 9 - 4 : 160;
+      dst[i] = sample;
+    }
+  }
+}
+
+/*
+ * Sends the planar samples in frames of the encoder's frame size, as many
+ * as the encoder takes and then the flush, and appends every packet to
+ * *out whenever it asks for them to be taken.
+ */
+static int encode(AVCodecContext *c, uint8_t *const *samples, int len, uint8_t **out, int *out_size){
+  AVPacket *pkt = av_packet_alloc();
+  AVFrame *frame = NULL;
+  int ret = 0, pos = 0, flushed = 0;
+
+  if (!pkt)
+    return AVERROR(ENOMEM);
+
+  do {
+    while (!flushed) {
+      if (!frame && pos < len) {
+        if (!(frame = av_frame_alloc()))
+          return AVERROR(ENOMEM);
+        frame->format         = AV_SAMPLE_FMT_U8P;
+        frame->channels       = c->channels;
+        frame->channel_layout = c->channel_layout;
+        frame->nb_samples     = FFMIN(c->frame_size, len - pos);
+        frame->pts            = pos;
+        if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+          return ret;
+        for (int ch = 0; ch < c->channels; ch++)
+          memcpy(frame->extended_data[ch], samples[ch] + pos, frame->nb_samples);
+        pos += frame->nb_samples;
+      }
+      ret = avcodec_send_frame(c, frame); // NULL once every sample is in
+      if (ret == AVERROR(EAGAIN))
+        break; // sent again once the packets are taken
+      if (ret < 0)
+        goto end;
+      flushed = !frame;
+      av_frame_free(&frame);
+    }
+
+    while ((ret = avcodec_receive_packet(c, pkt)) >= 0) {
+      *out = av_realloc(*out, *out_size + pkt->size);
+      if (!*out)
+        return AVERROR(ENOMEM);
+      memcpy(*out + *out_size, pkt->data, pkt->size);
+      *out_size += pkt->size;
+      av_packet_unref(pkt);
+    }
+  } while (ret == AVERROR(EAGAIN) && !flushed); // after the flush, only EOF may end it
+
+end:
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+  return ret == AVERROR_EOF && flushed ? 0 : ret; // a refused flush is an EOF too
+}
+
+static int run_test(int t, AVLFG *lfg){
+  const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_ASIF);
+  AVCodecContext *c = avcodec_alloc_context3(codec);
+  int len = tests[t].len, channels = tests[t].channels;
+  int block = tests[t].version == 2 ? tests[t].block_size : len;
+  uint8_t *samples[MAX_CHANNELS], *ref, *out = NULL, *p;
+  int out_size = 0, ret, differs;
+
+  ref = av_malloc((size_t)len * channels);
+  for (int ch = 0; ch < channels; ch++) {
+    samples[ch] = av_malloc(len);
+    gen_signal(lfg, samples[ch], len, ch % 3);
+  }
+
+  // every block holds each channel's deltas one after the other
+  p = ref;
+  for (int pos = 0; pos < len; pos += block) {
+    for (int ch = 0; ch < channels; ch++) {
+      encode_ref(p, samples[ch] + pos, FFMIN(block, len - pos));
+      p += FFMIN(block, len - pos);
+    }
+  }
+
+  c->sample_fmt     = AV_SAMPLE_FMT_U8P;
+  c->sample_rate    = 44100;
+  c->channels       = channels;
+  c->channel_layout = av_get_default_channel_layout(channels);
+  c->thread_count   = tests[t].threads;
+  av_opt_set_int(c->priv_data, "asif_version", tests[t].version, 0);
+  if (tests[t].version == 2)
+    av_opt_set_int(c->priv_data, "block_size", tests[t].block_size, 0);
+
+  if ((ret = avcodec_open2(c, codec, NULL)) >= 0)
+    ret = encode(c, samples, len, &out, &out_size);
+
+  differs = out_size != len * channels || (out_size && memcmp(out, ref, out_size));
+  if (ret < 0)
+    fprintf(stderr, "test %d: encoding failed (%d)\n", t, ret);
+  else if (differs)
+    fprintf(stderr, "test %d: version %d, %d threads, %d channels, %d samples: output differs\n",
+            t, tests[t].version, tests[t].threads, channels, len);
+  ret = ret < 0 || differs;
+
+  avcodec_free_context(&c);
+  for (int ch = 0; ch < channels; ch++)
+    av_free(samples[ch]);
+  av_free(ref);
+  av_free(out);
+  return ret;
+}
+
+int main(void){
+  AVLFG lfg;
+  int ret = 0;
+
+  av_lfg_init(&lfg, 0xA51F);
+  for (int t = 0; t < FF_ARRAY_ELEMS(tests); t++)
+    ret |= run_test(t, &lfg);
+
+  if (!ret)
+    printf("all %d encodes match\n", (int)FF_ARRAY_ELEMS(tests));
+  return ret;
+}
@@ -0,0 +1,122 @@
+;******************************************************************************
+;* ASIF DSP functions
+;*
+;* Nate Watanabe & Jonathan Vidal-Contreras
+;* April 20, 2020
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pb_15: times 32 db 15
+pb_80: times 32 db 0x80
+
+SECTION .text
+
+;-----------------------------------------------------------------------------
+; uint8_t ff_asif_prefix_sum(uint8_t *dst, const uint8_t *src, ptrdiff_t len,
+;                            int prev)
+;
+; Byte prefix sum in log steps: after adding the vector shifted by 1, 2, 4
+; and 8 bytes, every byte holds the sum of itself and all the bytes before
+; it in its 16-byte lane. The last sample of the previous vector is kept
+; broadcast in m0 and added to every byte.
+;-----------------------------------------------------------------------------
+%macro PREFIX_SUM 0
+cglobal asif_prefix_sum, 4, 4, 4, dst, src, len, prev
+    movd           xm0, prevd
+%if cpuflag(avx2)
+    vpbroadcastb    m0, xm0
+    mova            m3, [pb_15]
+%else
+    punpcklbw       m0, m0
+    pshuflw         m0, m0, q0000
+    punpcklqdq      m0, m0
+%endif
+    add           srcq, lenq
+    add           dstq, lenq
+    neg           lenq
+    jz .end
+.loop:
+    movu            m1, [srcq+lenq]
+    pslldq          m2, m1, 1
+    paddb           m1, m2
+    pslldq          m2, m1, 2
+    paddb           m1, m2
+    pslldq          m2, m1, 4
+    paddb           m1, m2
+    pslldq          m2, m1, 8
+    paddb           m1, m2
+%if cpuflag(avx2)
+    ; carry the total of the low lane into the high lane
+    pshufb          m2, m1, m3
+    vperm2i128      m2, m2, m2, 0x08
+    paddb           m1, m2
+%endif
+    paddb           m1, m0
+    movu [dstq+lenq], m1
+    ; broadcast the last byte as the carry for the next vector
+%if cpuflag(avx2)
+    pshufb          m0, m1, m3
+    vpermq          m0, m0, q3333
+%else
+    punpckhbw       m1, m1
+    pshufhw         m1, m1, q3333
+    punpckhqdq      m0, m1, m1
+%endif
+    add           lenq, mmsize
+    jl .loop
+.end:
+    movd           eax, xm0
+    movzx          eax, al
+    RET
+%endmacro
+
+;-----------------------------------------------------------------------------
+; int ff_asif_gen_deltas(uint8_t *dst, const uint8_t *src, ptrdiff_t len)
+;
+; Flipping the top bit turns the unsigned samples into signed bytes with
+; the same differences, so a saturating subtract gives the clamped delta
+; and a wrapping subtract the raw one. They only match where no clamping
+; is needed.
+;-----------------------------------------------------------------------------
+%macro GEN_DELTAS 0
+cglobal asif_gen_deltas, 3, 5, 5, dst, src, len, done, mask
+    xor          doned, doned
+    test          lenq, lenq
+    jz .end
+    mova            m4, [pb_80]
+.loop:
+    movu            m0, [srcq+doneq]
+    movu            m1, [srcq+doneq-1]
+    psubb           m2, m0, m1
+    pxor            m0, m4
+    pxor            m1, m4
+    psubsb          m0, m1
+    pcmpeqb         m0, m2
+    pmovmskb     maskd, m0
+%if mmsize == 32
+    cmp          maskd, -1
+%else
+    cmp          maskd, 0xffff
+%endif
+    jne .end
+    movu [dstq+doneq], m2
+    add          doneq, mmsize
+    cmp          doneq, lenq
+    jl .loop
+.end:
+    mov            eax, doned
+    RET
+%endmacro
+
+INIT_XMM sse2
+PREFIX_SUM
+GEN_DELTAS
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+PREFIX_SUM
+GEN_DELTAS
+%endif
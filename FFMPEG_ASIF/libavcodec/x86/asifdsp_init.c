@@ -0,0 +1,30 @@
+/*
+ * ASIF DSP functions
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavcodec/asifdsp.h"
+
+uint8_t ff_asif_prefix_sum_sse2(uint8_t *dst, const uint8_t *src, ptrdiff_t len, int prev);
+uint8_t ff_asif_prefix_sum_avx2(uint8_t *dst, const uint8_t *src, ptrdiff_t len, int prev);
+int ff_asif_gen_deltas_sse2(uint8_t *dst, const uint8_t *src, ptrdiff_t len);
+int ff_asif_gen_deltas_avx2(uint8_t *dst, const uint8_t *src, ptrdiff_t len);
+
+av_cold void ff_asifdsp_init_x86(ASIFDSPContext *c)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        c->prefix_sum = ff_asif_prefix_sum_sse2;
+        c->gen_deltas = ff_asif_gen_deltas_sse2;
+    }
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        c->prefix_sum = ff_asif_prefix_sum_avx2;
+        c->gen_deltas = ff_asif_gen_deltas_avx2;
+    }
+}
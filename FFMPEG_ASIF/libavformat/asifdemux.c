@@ -7,51 +7,305 @@
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/intreadwrite.h"
+#include "libavcodec/asif.h"
 #include "avformat.h"
+#include "internal.h"
 
+/*
+ * Version 1 files of unknown length, read from a pipe, are read to the
+ * end in pieces of this size.
+ */
+#define READ_CHUNK_SIZE (1 << 20)
+
+typedef struct ASIFDemuxContext {
+  int version;
+  int64_t next_pts; // timestamp of the next version 2 block
+  int64_t data_size; // size of the version 1 deltas, -1 when only the end of the file tells
+} ASIFDemuxContext;
+
+/*
+ * Checks for the tag and for sane stream parameters, so files are
+ * recognized by their content and not only by their extension.
+ */
+static int asif_probe(const AVProbeData *p){
+
+  ASIFHeader h;
+
+  if (asif_parse_header(&h, p->buf, p->buf_size) < 0)
+    return 0;
+
+  return AVPROBE_SCORE_MAX / 2;
+}
+
+/*
+ * Fills in the stream parameters that are the same for both versions.
+ */
+static void set_common_params(AVStream *st, const ASIFHeader *h){
+
+  AVCodecParameters *par = st->codecpar;
+
+  par->sample_rate           = h->sample_rate;
+  par->channels              = h->channels;
+  par->format                = AV_SAMPLE_FMT_U8P;
+  par->channel_layout        = av_get_default_channel_layout(par->channels);
+  par->bits_per_coded_sample = 8;
+  par->bit_rate              = (int64_t)par->sample_rate * par->channels * 8;
+
+  avpriv_set_pts_info(st, 64, 1, par->sample_rate);
+}
+
+/*
+ * Reads the seek index at the end of a version 2 file and adds an index
+ * entry for every block, so seeking is a single jump.
+ */
+static int read_seek_index(AVFormatContext *s, AVStream *st, int block_size){
+
+  AVIOContext *pb = s->pb;
+  int64_t size, index_pos, pos;
+  unsigned nb_blocks;
+
+  size = avio_size(pb);
+  if (size < ASIF_V2_HEADER_SIZE + 12)
+    return 0;
+
+  avio_seek(pb, size - 12, SEEK_SET);
+  index_pos = avio_rl64(pb);
+  if (avio_rl32(pb) != ASIF_INDEX_TAG || index_pos < ASIF_V2_HEADER_SIZE || index_pos > size - 16) {
+    av_log(s, AV_LOG_WARNING, "No seek index found\n");
+    return 0;
+  }
+
+  avio_seek(pb, index_pos, SEEK_SET);
+  nb_blocks = avio_rl32(pb);
+  if (nb_blocks > (size - 16 - index_pos) / 8)
+    return AVERROR_INVALIDDATA;
+
+  for (unsigned i = 0; i < nb_blocks; i++) {
+    pos = avio_rl64(pb);
+    av_add_index_entry(st, pos, (int64_t)i * block_size, 0, 0, AVINDEX_KEYFRAME);
+  }
+
+  return 0;
+}
+
+/*
+ * Version 2 files are parsed here rather than in the decoder, so the
+ * stream parameters and the layout are known before the first block.
+ */
+static int read_v2_header(AVFormatContext *s, AVStream *st, const ASIFHeader *h){
+
+  AVIOContext *pb = s->pb;
+  AVCodecParameters *par = st->codecpar;
+  int64_t data_start;
+  int ret;
+
+  if ((ret = ff_alloc_extradata(par, ASIF_EXTRADATA_SIZE)) < 0)
+    return ret;
+  AV_WL16(par->extradata,     h->version);
+  AV_WL16(par->extradata + 2, h->flags);
+  AV_WL32(par->extradata + 4, h->block_size);
+
+  if (h->flags & ASIF_FLAG_RICE)
+    par->bit_rate = 0; // entropy coded blocks vary in size
+
+  if (h->nb_samples != ASIF_UNKNOWN_SAMPLES)
+    st->duration = h->nb_samples;
+
+  if (s->pb->seekable & AVIO_SEEKABLE_NORMAL) {
+    data_start = avio_tell(pb);
+    if ((ret = read_seek_index(s, st, h->block_size)) < 0)
+      return ret;
+    avio_seek(pb, data_start, SEEK_SET);
+  }
+
+  return 0;
+}
+
+/*
+ * Reads the whole header, so the stream parameters and duration are known
+ * without reading any of the audio.
+ */
 static int asif_read_header(AVFormatContext *s){
-  
+
+  ASIFDemuxContext *asif = s->priv_data;
+  uint8_t buf[ASIF_V2_HEADER_SIZE];
+  ASIFHeader h;
+  unsigned nb_samples;
+  int ret;
+
   AVStream *st = avformat_new_stream(s, NULL);
   if (!st)
     return AVERROR(ENOMEM);
   st->codecpar->codec_type = AVMEDIA_TYPE_AUDIO; // set codec type
   st->codecpar->codec_id = s->iformat->raw_codec_id; // set codec ID
   st->start_time = 0;
-    return 0;
+
+  // the version 1 header is the start of the version 2 one
+  if ((ret = avio_read(s->pb, buf, ASIF_V1_HEADER_SIZE)) < 0)
+    return ret;
+  ret = asif_parse_header(&h, buf, ret);
+  if (ret == ASIF_ERR_TRUNCATED &&
+      avio_read(s->pb, buf + ASIF_V1_HEADER_SIZE, ASIF_V2_HEADER_SIZE - ASIF_V1_HEADER_SIZE) ==
+      ASIF_V2_HEADER_SIZE - ASIF_V1_HEADER_SIZE)
+    ret = asif_parse_header(&h, buf, ASIF_V2_HEADER_SIZE);
+  if (ret < 0)
+    return AVERROR_INVALIDDATA;
+
+  set_common_params(st, &h);
+  asif->version = h.version;
+  if (h.version == 2)
+    return read_v2_header(s, st, &h);
+
+  nb_samples = h.nb_samples;
+
+  if (nb_samples == ASIF_UNKNOWN_SAMPLES) { // written to a pipe, the deltas run to the end
+    asif->data_size = avio_size(s->pb) - ASIF_V1_HEADER_SIZE;
+    if (asif->data_size < 0) {
+      asif->data_size = -1;
+      return 0;
+    }
+    nb_samples = asif->data_size / st->codecpar->channels;
+  }
+
+  st->duration = nb_samples;
+  asif->data_size = (int64_t)nb_samples * st->codecpar->channels;
+  if (asif->data_size > INT_MAX)
+    return AVERROR_PATCHWELCOME;
+
+  // the single packet is the only place to seek to
+  av_add_index_entry(st, ASIF_V1_HEADER_SIZE, 0, asif->data_size, 0, AVINDEX_KEYFRAME);
+
+  return 0;
 }
 
 /*
- * Reads data from the AVIOContext to an AVPacket
+ * Reads one version 2 block into an AVPacket, leaving out the block header.
  */
-static int asif_read_packet(AVFormatContext *s, AVPacket *pkt){
-   
-  int ret, size;
-  size = avio_size(s->pb); // prepare size of the AVPacket
+static int read_block(AVFormatContext *s, AVPacket *pkt){
+
+  ASIFDemuxContext *asif = s->priv_data;
+  int64_t pos = avio_tell(s->pb);
+  unsigned nb_samples, size;
+  int ret;
+
+  nb_samples = avio_rl32(s->pb);
+  size       = avio_rl32(s->pb);
+
+  if (avio_feof(s->pb) || !nb_samples)
+    return AVERROR_EOF;
+  if (size > INT_MAX)
+    return AVERROR_INVALIDDATA;
+
+  if ((ret = av_get_packet(s->pb, pkt, size)) < 0)
+    return ret;
+
+  // the channels are laid out by the block's length, so a cut block cannot be split
+  if (ret < size) {
+    av_log(s, AV_LOG_ERROR, "Block truncated: %d of %u bytes\n", ret, size);
+    av_packet_unref(pkt);
+    return AVERROR_INVALIDDATA;
+  }
+
+  pkt->pos          = pos;
+  pkt->stream_index = 0;
+  pkt->pts          = asif->next_pts;
+  pkt->duration     = nb_samples;
+  pkt->flags       |= AV_PKT_FLAG_KEY;
+  asif->next_pts   += nb_samples;
+
+  return 0;
+}
+
+/*
+ * Reads version 1 deltas of unknown length, up to the end of the input.
+ */
+static int read_to_eof(AVFormatContext *s, AVPacket *pkt){
+
+  int ret;
 
-  if ((ret = av_new_packet(pkt, size)) < 0)
+  if (avio_feof(s->pb))
+    return AVERROR_EOF;
+
+  if ((ret = av_get_packet(s->pb, pkt, READ_CHUNK_SIZE)) < 0)
     return ret;
-  
-  pkt->pos = avio_tell(s->pb);
+  while (!avio_feof(s->pb) && av_append_packet(s->pb, pkt, READ_CHUNK_SIZE) >= 0)
+    ;
+
   pkt->stream_index = 0;
+  pkt->pts = 0;
+  pkt->duration = pkt->size / s->streams[0]->codecpar->channels;
+  pkt->flags |= AV_PKT_FLAG_KEY;
+  return 0;
+}
+
+/*
+ * Reads data from the AVIOContext to an AVPacket
+ */
+static int asif_read_packet(AVFormatContext *s, AVPacket *pkt){
+
+  ASIFDemuxContext *asif = s->priv_data;
+  int ret;
+
+  if (asif->version == 2)
+    return read_block(s, pkt);
+
+  if (asif->data_size < 0)
+    return read_to_eof(s, pkt);
+
+  // version 1 deltas are all read as one packet
+  if (avio_tell(s->pb) >= ASIF_V1_HEADER_SIZE + asif->data_size)
+    return AVERROR_EOF;
 
   // read the data into the packet
-  ret = avio_read(s->pb, pkt->data, size);
+  ret = av_get_packet(s->pb, pkt, asif->data_size);
+  if (ret < 0)
+    return ret;
 
-  if (ret < 0) {
+  // the channels are laid out by the header's length, so a cut file cannot be split
+  if (ret < asif->data_size) {
+    av_log(s, AV_LOG_ERROR, "File truncated: %d of %"PRId64" bytes of samples\n", ret, asif->data_size);
     av_packet_unref(pkt);
-    return ret;
+    return AVERROR_INVALIDDATA;
   }
 
-  av_shrink_packet(pkt, ret);
+  pkt->stream_index = 0;
+  pkt->pts = 0;
+  pkt->duration = s->streams[0]->duration;
+  pkt->flags |= AV_PKT_FLAG_KEY;
   return ret;
 }
 
+/*
+ * Jumps straight to the version 2 block holding the timestamp. Version 1
+ * files are a single packet, so they can only go back to the start.
+ */
+static int asif_read_seek(AVFormatContext *s, int stream_index, int64_t timestamp, int flags){
+
+  ASIFDemuxContext *asif = s->priv_data;
+  AVStream *st = s->streams[0];
+  int index;
+
+  index = av_index_search_timestamp(st, timestamp, flags);
+  if (index < 0)
+    return -1;
+
+  if (avio_seek(s->pb, st->index_entries[index].pos, SEEK_SET) < 0)
+    return -1;
+  asif->next_pts = st->index_entries[index].timestamp;
+
+  return 0;
+}
+
 AVInputFormat ff_asif_demuxer = {
   .name           = "asif",
-  .priv_data_size = 0,
+  .priv_data_size = sizeof(ASIFDemuxContext),
   .long_name      = NULL_IF_CONFIG_SMALL("ASIF audio file (CS 3505 Spring 20202)"),
   .extensions     = "asif",
+  .read_probe     = asif_probe,
   .read_header    = asif_read_header,
   .read_packet    = asif_read_packet,
+  .read_seek      = asif_read_seek,
   .raw_codec_id   = AV_CODEC_ID_ASIF,
 };
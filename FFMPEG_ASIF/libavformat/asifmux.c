@@ -7,28 +7,80 @@
 
 #include "avformat.h"
 #include "avio.h"
+#include "internal.h"
 #include "../libavcodec/avcodec.h"
+#include "../libavcodec/asif.h"
 #include "../libavutil/avutil.h"
+#include "../libavutil/intreadwrite.h"
+#include "../libavutil/mem.h"
+
+typedef struct ASIFMuxContext {
+  int version;
+  int64_t samples_pos;  // where the samples per channel go in the header
+  int64_t nb_samples;   // samples per channel written so far
+  int64_t *block_pos;   // file offset of every version 2 block, for the seek index
+  int nb_blocks;
+} ASIFMuxContext;
+
+/*
+ * Counts time in samples, so packet durations add up to the number of
+ * samples per channel written in the header.
+ */
+static int asif_init(AVFormatContext *s)
+{
+  AVCodecParameters *params = s->streams[0]->codecpar;
+
+  avpriv_set_pts_info(s->streams[0], 64, 1, params->sample_rate);
+  return 0;
+}
 
 /*
- * Writes the header information to the AVIOContext of the input
+ * Writes the number of samples per channel. On seekable outputs this is a
+ * placeholder that asif_write_trailer fills in; otherwise it says that the
+ * length is unknown and readers should read to the end.
+ */
+static void write_sample_count(AVFormatContext *s)
+{
+  ASIFMuxContext *asif = s->priv_data;
+  AVIOContext *pb = s->pb;
+
+  asif->samples_pos = avio_tell(pb);
+  if (pb->seekable & AVIO_SEEKABLE_NORMAL)
+    avio_wl32(pb, 0);
+  else
+    avio_wl32(pb, ASIF_UNKNOWN_SAMPLES);
+}
+
+/*
+ * Writes the header information to the AVIOContext of the input.
+ * Version 2 headers also have the block size and flags.
  */
 static int asif_write_header(AVFormatContext *s)
 {
+  ASIFMuxContext *asif = s->priv_data;
   AVIOContext *pb = s->pb;
   AVCodecParameters *params = s->streams[0]->codecpar;
 
-  // Write in the "asif" tag
-  const char asif[4] = "asif";
-  avio_write(pb, asif, 4); 
-  
+  asif->version = 1;
+  if (params->extradata_size >= ASIF_EXTRADATA_SIZE)
+    asif->version = AV_RL16(params->extradata);
+
+  // Write in the "asif" (or "asi2") tag
+  avio_wl32(pb, asif->version == 2 ? ASIF_V2_TAG : ASIF_TAG);
+
   // Write in the sample rate {32-bit little endian int}
   avio_wl32(pb, params->sample_rate);
-  
+
   // Write in # of channels {16-bit little endian int}
   avio_wl16(pb, params->channels);
 
-  /* # of samples per channel is already written in the encoder */
+  // Write in # of samples per channel {32-bit little endian int}
+  write_sample_count(s);
+
+  if (asif->version == 2) {
+    avio_wl32(pb, AV_RL32(params->extradata + 4)); // block size
+    avio_wl16(pb, AV_RL16(params->extradata + 2)); // flags
+  }
 
   return 0;
 }
@@ -36,20 +88,95 @@ static int asif_write_header(AVFormatContext *s)
 /* Writes from a data packet to an AVFormatContext */
 static int asif_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
+  ASIFMuxContext *asif = s->priv_data;
   AVIOContext *pb = s->pb;
+  int64_t *pos;
+
+  if (asif->version == 2) { // remember where the block starts, then frame it
+    pos = av_dynarray2_add((void **)&asif->block_pos, &asif->nb_blocks,
+                           sizeof(*asif->block_pos), NULL);
+    if (!pos)
+      return AVERROR(ENOMEM);
+    *pos = avio_tell(pb);
+
+    avio_wl32(pb, pkt->duration);
+    avio_wl32(pb, pkt->size);
+  }
+  asif->nb_samples += pkt->duration;
 
   avio_write(pb, pkt->data, pkt->size);
 
   return 0;
 }
 
+/*
+ * Ends the version 2 block list and writes the seek index.
+ */
+static void write_seek_index(AVFormatContext *s)
+{
+  ASIFMuxContext *asif = s->priv_data;
+  AVIOContext *pb = s->pb;
+  int64_t index_pos;
+
+  // a block with no samples marks the end of the data
+  avio_wl32(pb, 0);
+  avio_wl32(pb, 0);
+
+  index_pos = avio_tell(pb);
+  avio_wl32(pb, asif->nb_blocks);
+  for (int i = 0; i < asif->nb_blocks; i++)
+    avio_wl64(pb, asif->block_pos[i]);
+  avio_wl64(pb, index_pos);
+  avio_wl32(pb, ASIF_INDEX_TAG);
+}
+
+/*
+ * Ends the version 2 block list and writes the seek index, then fills in
+ * the number of samples per channel in the header.
+ */
+static int asif_write_trailer(AVFormatContext *s)
+{
+  ASIFMuxContext *asif = s->priv_data;
+  AVIOContext *pb = s->pb;
+  int64_t end;
+
+  if (asif->version == 2)
+    write_seek_index(s);
+
+  if (!(pb->seekable & AVIO_SEEKABLE_NORMAL))
+    return 0; // the header already says the length is unknown
+
+  if (asif->nb_samples >= ASIF_UNKNOWN_SAMPLES) {
+    av_log(s, AV_LOG_WARNING, "Too many samples for the header, the length is left unknown\n");
+    asif->nb_samples = ASIF_UNKNOWN_SAMPLES;
+  }
+
+  end = avio_tell(pb);
+  avio_seek(pb, asif->samples_pos, SEEK_SET);
+  avio_wl32(pb, asif->nb_samples);
+  avio_seek(pb, end, SEEK_SET);
+
+  return 0;
+}
+
+static void asif_deinit(AVFormatContext *s)
+{
+  ASIFMuxContext *asif = s->priv_data;
+
+  av_freep(&asif->block_pos);
+}
+
 AVOutputFormat ff_asif_muxer = {
     .name              = "asif",
     .long_name         = NULL_IF_CONFIG_SMALL("ASIF audio file (CS 3505 Spring 20202)"),
     .mime_type         = "audio",
     .extensions        = "asif",
+    .priv_data_size    = sizeof(ASIFMuxContext),
     .audio_codec       = AV_CODEC_ID_ASIF,
     .video_codec       = AV_CODEC_ID_NONE,
+    .init              = asif_init,
     .write_header      = asif_write_header,
     .write_packet      = asif_write_packet,
+    .write_trailer     = asif_write_trailer,
+    .deinit            = asif_deinit,
 };
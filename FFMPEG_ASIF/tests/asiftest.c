@@ -0,0 +1,273 @@
+/*
+ * asiftest: helpers for the ASIF regression run in run.sh.
+ *
+ * Usage: asiftest gen kind channels samples seed
+ *        asiftest model block_size channels
+ *        asiftest dec file.asif
+ *        asiftest seek file.asif
+ *        asiftest sink [bytes]
+ *
+ * gen writes a test signal as interleaved unsigned 8-bit samples to stdout.
+ * model reads such samples on stdin and writes what decoding an ASIF file
+ * of them must give: every block starts on its first sample and each later
+ * delta is clamped to a byte, so the output catches up with big jumps a
+ * few samples late (block_size 0 = one block, as in version 1). dec decodes
+ * a file with libasif and writes its samples interleaved to stdout. seek
+ * reads random ranges of single channels from a file and compares them
+ * with the whole file read in order. sink reads stdin to the end, for
+ * bench.sh: it reports when the first bytes came and the speed at which
+ * they, or the given number of bytes (the input of an encoder), went
+ * through.
+ *
+ * Nate Watanabe & Jonathan Vidal-Contreras
+ * April 20, 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libasif.h"
+
+#define CHUNK_SAMPLES (1 << 16) // samples per channel handled at a time
+
+static const char *const kinds[] = {
+  "silence", // all 128
+  "sine",    // smooth, small deltas
+  "ramp",    // slow ramps with a jump now and then
+  "noise",   // white noise, a quarter of the deltas need clamping
+  "square",  // full-scale square waves with random periods
+  "flip",    // 0 and 255 in turn, every delta needs clamping
+  NULL
+};
+
+static uint32_t rand_state;
+
+/*
+ * Same numbers on every platform, so the reference checksums hold.
+ */
+static uint32_t next_rand(void){
+  rand_state = rand_state * 1664525 + 1013904223;
+  return rand_state >> 8;
+}
+
+static uint8_t gen_sample(int kind, long i, int channel, uint8_t prev, int period){
+  switch (kind) {
+  case 0:
+    return 128;
+  case 1: // a triangle-ish sine without libm: a parabola per half period
+    {
+      long t = (i + channel * 7) % (2 * period), half = t < period ? t : t - period;
+      int y = 4 * 100 * half * (period - half) / ((long)period * period);
+      return t < period ? 128 + y : 128 - y;
+    }
+  case 2:
+    return prev + (next_rand() % 600 ? (int)(next_rand() % 9) - 4 : 150);
+  case 3:
+    return next_rand();
+  case 4:
+    return (i / period) & 1 ? 255 : 0;
+  default:
+    return (i + channel) & 1 ? 255 : 0;
+  }
+}
+
+static int gen(const char *name, int channels, long nb_samples, uint32_t seed){
+  uint8_t *prev, *buf;
+  int *period, kind;
+  long n;
+
+  for (kind = 0; kinds[kind] && strcmp(kinds[kind], name); kind++)
+    ;
+  if (!kinds[kind]) {
+    fprintf(stderr, "unknown signal %s\n", name);
+    return 1;
+  }
+
+  rand_state = seed;
+  prev   = malloc(channels);
+  period = malloc(channels * sizeof(*period));
+  buf    = malloc((size_t)CHUNK_SAMPLES * channels);
+  if (!prev || !period || !buf)
+    return 1;
+  for (int c = 0; c < channels; c++) {
+    prev[c]   = next_rand();
+    period[c] = 2 + next_rand() % 300;
+  }
+
+  for (long pos = 0; pos < nb_samples; pos += n) {
+    n = nb_samples - pos < CHUNK_SAMPLES ? nb_samples - pos : CHUNK_SAMPLES;
+    for (long i = 0; i < n; i++)
+      for (int c = 0; c < channels; c++)
+        buf[i * channels + c] = prev[c] = gen_sample(kind, pos + i, c, prev[c], period[c]);
+    fwrite(buf, channels, n, stdout);
+  }
+
+  free(prev);
+  free(period);
+  free(buf);
+  return 0;
+}
+
+/*
+ * The closed-loop encoder and the decoder in one: the output is the
+ * encoder's rebuilt signal.
+ */
+static int model(long block_size, int channels){
+  uint8_t *buf, *out;
+  long pos = 0; // sample in the current block
+  int delta;
+  size_t n;
+
+  buf = malloc((size_t)CHUNK_SAMPLES * channels);
+  out = calloc(channels, 1);
+  if (!buf || !out)
+    return 1;
+
+  while ((n = fread(buf, channels, CHUNK_SAMPLES, stdin)) > 0) {
+    for (size_t i = 0; i < n; i++, pos++) {
+      if (block_size && pos == block_size)
+        pos = 0;
+      for (int c = 0; c < channels; c++) {
+        delta = buf[i * channels + c] - out[c];
+        if (delta > 127)
+          delta = 127;
+        else if (delta < -128)
+          delta = -128;
+        out[c] = pos ? out[c] + delta : buf[i * channels + c];
+        buf[i * channels + c] = out[c];
+      }
+    }
+    fwrite(buf, channels, n, stdout);
+  }
+
+  free(buf);
+  free(out);
+  return 0;
+}
+
+static int dec(const char *path){
+  ASIFFile *file;
+  ASIFReader *reader = NULL;
+  uint8_t *buf;
+  int64_t n = 0;
+  int channels, ret;
+
+  if ((ret = asif_open(&file, path)) < 0) {
+    fprintf(stderr, "%s: %s\n", path, asif_strerror(ret));
+    return 1;
+  }
+  channels = asif_get_header(file)->channels;
+  buf = malloc((size_t)CHUNK_SAMPLES * channels);
+  if (!buf)
+    ret = ASIF_ERR_NOMEM;
+  else
+    ret = asif_reader_open(&reader, file);
+
+  while (!ret && (n = asif_reader_read(reader, buf, CHUNK_SAMPLES)) > 0)
+    fwrite(buf, channels, n, stdout);
+  if (!ret && n < 0)
+    ret = n;
+  if (ret < 0)
+    fprintf(stderr, "%s: %s\n", path, asif_strerror(ret));
+
+  free(buf);
+  asif_reader_close(reader);
+  asif_close(file);
+  return ret < 0;
+}
+
+static int seek(const char *path){
+  ASIFFile *file;
+  ASIFReader *reader = NULL;
+  uint8_t *all = NULL, *part = NULL;
+  uint64_t nb_samples, start, count;
+  int channels, c, ret;
+
+  if ((ret = asif_open(&file, path)) < 0) {
+    fprintf(stderr, "%s: %s\n", path, asif_strerror(ret));
+    return 1;
+  }
+  channels   = asif_get_header(file)->channels;
+  nb_samples = asif_get_nb_samples(file);
+  all  = malloc(nb_samples * channels + 1);
+  part = malloc(nb_samples + 1);
+  if (!all || !part)
+    ret = ASIF_ERR_NOMEM;
+  else if (!(ret = asif_reader_open(&reader, file)) &&
+           (ret = asif_reader_read(reader, all, nb_samples)) == nb_samples)
+    ret = 0;
+  else if (ret >= 0)
+    ret = ASIF_ERR_INVALID;
+
+  rand_state = nb_samples;
+  for (int t = 0; !ret && nb_samples && t < 100; t++) {
+    c     = next_rand() % channels;
+    start = next_rand() % nb_samples;
+    count = next_rand() % (nb_samples - start + 1);
+    if ((ret = asif_read_channel(file, c, start, count, part, 1)) < 0)
+      break;
+    for (uint64_t i = 0; i < count; i++)
+      if (part[i] != all[(start + i) * channels + c]) {
+        fprintf(stderr, "%s: channel %d from %llu differs at %llu\n", path, c,
+                (unsigned long long)start, (unsigned long long)(start + i));
+        ret = 1;
+        break;
+      }
+  }
+  if (ret < 0)
+    fprintf(stderr, "%s: %s\n", path, asif_strerror(ret));
+
+  free(all);
+  free(part);
+  asif_reader_close(reader);
+  asif_close(file);
+  return ret != 0;
+}
+
+static double now(void){
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int sink(double bytes){
+  static uint8_t buf[1 << 16];
+  double start = now(), first = 0, secs;
+  uint64_t total = 0;
+  size_t n;
+
+  while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+    if (!total)
+      first = now() - start;
+    total += n;
+  }
+  secs = now() - start;
+  if (!bytes)
+    bytes = total;
+
+  printf("%.1f MB/s, first output after %.1f ms, %.1f MB out in %.3f s\n",
+         secs > 0 ? bytes / 1e6 / secs : 0, first * 1e3, total / 1e6, secs);
+  return 0;
+}
+
+int main(int argc, char **argv){
+  if (argc == 6 && !strcmp(argv[1], "gen"))
+    return gen(argv[2], atoi(argv[3]), atol(argv[4]), strtoul(argv[5], NULL, 0));
+  if (argc == 4 && !strcmp(argv[1], "model"))
+    return model(atol(argv[2]), atoi(argv[3]));
+  if (argc == 3 && !strcmp(argv[1], "dec"))
+    return dec(argv[2]);
+  if (argc == 3 && !strcmp(argv[1], "seek"))
+    return seek(argv[2]);
+  if ((argc == 2 || argc == 3) && !strcmp(argv[1], "sink"))
+    return sink(argc == 3 ? atof(argv[2]) : 0);
+
+  fprintf(stderr, "Usage: asiftest gen kind channels samples seed\n"
+                  "       asiftest model block_size channels\n"
+                  "       asiftest dec file.asif\n"
+                  "       asiftest seek file.asif\n"
+                  "       asiftest sink [bytes]\n");
+  return 2;
+}
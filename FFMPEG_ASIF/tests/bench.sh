@@ -0,0 +1,93 @@
+#!/bin/sh
+#
+# Compares the ASIF modes on the same audio: the compression ratio (bytes
+# of samples per byte of file, 1.00 for plain ASIF), the encoding and
+# decoding MB/s (bytes of samples per second) with ffmpeg, the time until
+# the first decoded samples come out of ffmpeg and libasif's decoding speed
+# (asifconv -n). ffmpeg's own peak memory is shown when it prints it
+# (-benchmark).
+#
+# Usage: bench.sh [file]
+#        bench.sh -g [signal] [seconds]
+#   file is decoded to 8-bit stereo samples as in run.sh (default
+#   ../bach.mp3; if ffmpeg cannot decode it, a generated signal is used).
+#   -g generates seconds of 44.1 kHz stereo (default 600) of a signal as
+#   for "asiftest gen" (default ramp). FFMPEG=/path/to/ffmpeg as in run.sh,
+#   THREADS sets the decoding threads (default 4).
+#
+# Nate Watanabe & Jonathan Vidal-Contreras
+# April 20, 2020
+
+cd "$(dirname "$0")" || exit 1
+FFMPEG=${FFMPEG:-ffmpeg}
+THREADS=${THREADS:-4}
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT INT TERM
+
+if [ ! -x ./asiftest ] || [ ! -x ../libasif/asifconv ]; then
+  echo "asiftest or asifconv is missing, run make bench"
+  exit 1
+fi
+
+# generate signal seconds
+generate() {
+  ./asiftest gen "$1" 2 $((44100 * $2)) 1 > "$TMP/in.raw"
+  input="$1, $2 s"
+}
+
+if [ "$1" = -g ]; then
+  generate "${2:-ramp}" "${3:-600}"
+elif $FFMPEG -nostdin -v error -i "${1:-../bach.mp3}" -ac 2 -ar 44100 -f u8 -y "$TMP/in.raw" 2> /dev/null; then
+  input=$(basename "${1:-../bach.mp3}")
+elif [ -z "$1" ]; then
+  echo "$FFMPEG cannot decode ../bach.mp3, using a generated signal"
+  generate ramp 600
+else
+  echo "$FFMPEG cannot decode $1"
+  exit 1
+fi
+bytes=$(wc -c < "$TMP/in.raw")
+
+# the first field of a line of asiftest sink: MB/s
+speed() {
+  echo "$1" | sed 's| MB/s.*||'
+}
+
+# the maxrss of -benchmark in kB, if any
+maxrss() {
+  grep -o 'maxrss=[0-9]*' "$TMP/log" | sed 's/maxrss=//' | tail -n 1
+}
+
+awk "BEGIN { printf \"%s: %.1f MB of stereo samples\\n\", \"$input\", $bytes / 1e6 }"
+printf '%-5s %9s %6s %12s %12s %12s %9s %12s %9s\n' mode "file MB" ratio "encode MB/s" \
+       "dec MB/s x1" "dec MB/s x$THREADS" "first ms" "libasif MB/s" "peak kB"
+
+for mode in v1 v2 rice; do
+  case $mode in
+  v1)   opts="-asif_version 1" ;;
+  v2)   opts="-asif_version 2" ;;
+  rice) opts="-asif_version 2 -rice 1" ;;
+  esac
+
+  # the input is read while encoding, so the speed is over its bytes
+  result=$($FFMPEG -nostdin -hide_banner -nostats -benchmark -f u8 -ar 44100 -ac 2 -i "$TMP/in.raw" \
+             -c:a asif $opts -f asif - 2> "$TMP/log" | ./asiftest sink $bytes)
+  encode=$(speed "$result")
+  $FFMPEG -nostdin -v error -f u8 -ar 44100 -ac 2 -i "$TMP/in.raw" -c:a asif $opts -y "$TMP/$mode.asif"
+  size=$(wc -c < "$TMP/$mode.asif")
+
+  result=$($FFMPEG -nostdin -hide_banner -nostats -threads 1 -i "$TMP/$mode.asif" \
+             -f u8 - 2> /dev/null | ./asiftest sink)
+  decode1=$(speed "$result")
+  result=$($FFMPEG -nostdin -hide_banner -nostats -benchmark -threads $THREADS -i "$TMP/$mode.asif" \
+             -f u8 - 2> "$TMP/log" | ./asiftest sink)
+  decode=$(speed "$result")
+  first=$(echo "$result" | sed 's|.*after \([0-9.]*\) ms.*|\1|')
+  peak=$(maxrss)
+
+  lib=$(../libasif/asifconv -n "$TMP/$mode.asif" | sed -n '1s|.*(\([0-9.]*\) MB/s).*|\1|p')
+
+  awk "BEGIN { printf \"%-5s %9.1f %6.2f %12s %12s %12s %9s %12s %9s\\n\", \"$mode\", $size / 1e6,
+               $bytes / $size, \"$encode\", \"$decode1\", \"$decode\", \"$first\", \"${lib:--}\",
+               \"${peak:--}\" }"
+done
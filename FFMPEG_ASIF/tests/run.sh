@@ -0,0 +1,206 @@
+#!/bin/sh
+#
+# Regression run for the ASIF encoder, decoder, muxer and demuxer.
+#
+# Generates test signals with asiftest, encodes them with ffmpeg as
+# version 1, version 2 and Rice coded files and decodes them again, and
+# checks that:
+#  - the files and the decoded samples match the checksums in ref.md5,
+#  - 1 and 4 threads, and other output frame sizes, give the same bytes,
+#  - ffmpeg, libasif (reading in order or from anywhere) and the
+#    closed-loop model in asiftest agree,
+#  - cut-off files give no samples, or only the whole blocks before the cut.
+# bach.mp3 goes through the same checks without fixed checksums, since
+# mp3 decoders do not all give the same samples.
+#
+# Usage: run.sh [-u]
+#   -u writes ref.md5 again, after a change that is meant to alter the files.
+#   FFMPEG=/path/to/ffmpeg picks the ffmpeg to test (default: ffmpeg in PATH).
+#
+# Nate Watanabe & Jonathan Vidal-Contreras
+# April 20, 2020
+
+cd "$(dirname "$0")" || exit 1
+FFMPEG=${FFMPEG:-ffmpeg}
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT INT TERM
+
+update=0
+[ "$1" = -u ] && update=1
+nb_tests=0
+nb_failed=0
+
+md5() {
+  md5sum < "$1" | cut -d ' ' -f 1
+}
+
+fail() {
+  echo "FAIL $name: $*"
+  nb_failed=$((nb_failed + 1))
+}
+
+# encode raw_file channels threads "options" out_file
+encode() {
+  $FFMPEG -nostdin -v error -f u8 -ar 44100 -ac "$2" -i "$1" -threads "$3" -c:a asif $4 -y "$5"
+}
+
+# decode asif_file threads "options" out_file
+decode() {
+  $FFMPEG -nostdin -v error -threads "$2" $3 -i "$1" -f u8 -y "$4"
+}
+
+# Encodes $TMP/in.raw in one mode and checks every way of decoding it.
+# Leaves the file in $TMP/a.asif and its samples in $TMP/d1.raw.
+# round_trip channels mode block_size
+round_trip() {
+  case $2 in
+  v1)   opts="-asif_version 1"; block=0 ;;
+  v2)   opts="-asif_version 2 -block_size $3"; block=$3 ;;
+  rice) opts="-asif_version 2 -block_size $3 -rice 1"; block=$3 ;;
+  esac
+
+  if ! encode "$TMP/in.raw" "$1" 1 "$opts" "$TMP/a.asif"; then
+    fail "encoding failed"
+    return 1
+  fi
+  encode "$TMP/in.raw" "$1" 4 "$opts" "$TMP/b.asif"
+  cmp -s "$TMP/a.asif" "$TMP/b.asif" || fail "4 encoding threads give another file"
+
+  if ! decode "$TMP/a.asif" 1 "" "$TMP/d1.raw"; then
+    fail "decoding failed"
+    return 1
+  fi
+  decode "$TMP/a.asif" 4 "" "$TMP/d4.raw"
+  cmp -s "$TMP/d1.raw" "$TMP/d4.raw" || fail "4 decoding threads give other samples"
+  decode "$TMP/a.asif" 4 "-frame_samples 0" "$TMP/d0.raw"
+  cmp -s "$TMP/d1.raw" "$TMP/d0.raw" || fail "one frame per packet gives other samples"
+  decode "$TMP/a.asif" 1 "-frame_samples 1000" "$TMP/df.raw"
+  cmp -s "$TMP/d1.raw" "$TMP/df.raw" || fail "1000 sample frames give other samples"
+
+  ./asiftest dec "$TMP/a.asif" > "$TMP/lib.raw" || fail "libasif could not decode"
+  cmp -s "$TMP/d1.raw" "$TMP/lib.raw" || fail "libasif decodes other samples"
+  ./asiftest seek "$TMP/a.asif" || fail "libasif reads other samples from the middle"
+  ./asiftest model "$block" "$1" < "$TMP/in.raw" > "$TMP/model.raw"
+  cmp -s "$TMP/d1.raw" "$TMP/model.raw" || fail "the samples are not the closed-loop ones"
+  return 0
+}
+
+# check signal channels samples mode [block_size]
+check() {
+  name=$1-${2}ch-$3-$4${5:+-$5}
+  nb_tests=$((nb_tests + 1))
+
+  ./asiftest gen "$1" "$2" "$3" "$(($2 * 1000 + $3))" > "$TMP/in.raw"
+  round_trip "$2" "$4" "${5:-4096}" || return
+
+  sums="$name $(md5 "$TMP/a.asif") $(md5 "$TMP/d1.raw")"
+  if [ $update = 1 ]; then
+    echo "$sums" >> "$TMP/ref.md5"
+  elif ! grep -qx "$sums" ref.md5; then
+    if grep -q "^$name " ref.md5; then
+      fail "checksums differ from ref.md5"
+    else
+      fail "not in ref.md5"
+    fi
+  fi
+}
+
+# Cuts $TMP/a.asif after some bytes. ffmpeg must give the samples of the
+# whole blocks before the cut (none for version 1), and so must libasif,
+# unless it refuses the file ("fail"), as it does when a block is cut.
+# check_cut bytes samples_left channels ok|fail
+check_cut() {
+  name="$base cut at $1"
+  nb_tests=$((nb_tests + 1))
+  head -c "$1" "$TMP/a.asif" > "$TMP/cut.asif"
+  head -c $(($2 * $3)) "$TMP/d1.raw" > "$TMP/left.raw"
+
+  : > "$TMP/dcut.raw" # ffmpeg writes nothing when there is nothing to decode
+  decode "$TMP/cut.asif" 1 "" "$TMP/dcut.raw" 2> /dev/null
+  cmp -s "$TMP/dcut.raw" "$TMP/left.raw" ||
+    fail "ffmpeg gives $(wc -c < "$TMP/dcut.raw") bytes of samples, not $(($2 * $3))"
+
+  if ./asiftest dec "$TMP/cut.asif" > "$TMP/lcut.raw" 2> /dev/null; then
+    [ "$4" = ok ] || fail "libasif does not refuse the file"
+    cmp -s "$TMP/lcut.raw" "$TMP/left.raw" || fail "libasif gives other samples"
+  else
+    [ "$4" = fail ] || fail "libasif refuses the file"
+  fi
+}
+
+if [ ! -x ./asiftest ]; then
+  echo "asiftest is missing, run make first"
+  exit 1
+fi
+
+# every signal, including the clamp-heavy ones, in every mode
+for signal in silence sine ramp noise square flip; do
+  for mode in v1 v2 rice; do
+    check $signal 2 10000 $mode
+  done
+done
+
+# 1 to 16 channels
+for ch in 1 3 4 5 6 7 8 9 10 11 12 13 14 15 16; do
+  for mode in v1 v2 rice; do
+    check ramp $ch 3000 $mode 1000
+  done
+done
+
+# no samples at all, and tiny lengths around the 16 and 32 sample SIMD
+# steps and the block size
+for len in 0 1 2 15 16 17 31 32 33 63 65; do
+  for mode in v1 v2 rice; do
+    check noise 2 $len $mode 32
+  done
+done
+for len in 4095 4096 4097 8192; do
+  check flip 1 $len v2
+  check ramp 1 $len rice
+done
+
+# long enough for the parallel decoder, and blocks of odd and maximum size
+check ramp 2 300001 v1
+check noise 1 400000 v1
+check sine 2 300001 v2 65536
+check ramp 2 300001 rice 1000
+check noise 3 1048577 v2 1048576
+
+# cut-off files: in the header, before the samples, in the samples, and
+# for version 2 (blocks of 8 + 2000 bytes here) between blocks
+check noise 2 5000 v1
+base=$name
+for bytes in 10 14 1014 10013; do
+  check_cut $bytes 0 2 fail
+done
+check noise 2 5000 v2 1000
+base=$name
+check_cut 10 0 2 fail
+check_cut 20 0 2 ok
+check_cut 28 0 2 fail
+check_cut 1028 0 2 fail
+check_cut 2028 1000 2 ok
+check_cut 4036 2000 2 ok
+check_cut 5000 2000 2 fail
+
+# bach.mp3, through raw samples so the model can be checked too
+name=bach.mp3
+if $FFMPEG -nostdin -v error -i ../bach.mp3 -ac 2 -f u8 -y "$TMP/in.raw" 2> /dev/null; then
+  for mode in v1 v2 rice; do
+    name=bach.mp3-$mode
+    nb_tests=$((nb_tests + 1))
+    round_trip 2 $mode 4096 && cp "$TMP/d1.raw" "$TMP/bach-$mode.raw"
+  done
+  name=bach.mp3
+  nb_tests=$((nb_tests + 1))
+  cmp -s "$TMP/bach-v2.raw" "$TMP/bach-rice.raw" || fail "Rice coding changes the samples"
+else
+  echo "skipped bach.mp3: $FFMPEG cannot decode it"
+fi
+
+if [ $update = 1 ]; then
+  cp "$TMP/ref.md5" ref.md5
+  echo "wrote ref.md5 from $nb_tests tests"
+fi
+echo "$nb_tests tests, $nb_failed failures"
+[ $nb_failed = 0 ]